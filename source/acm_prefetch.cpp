@@ -0,0 +1,171 @@
+#include "acm_prefetch.hpp"
+
+#ifdef _3DS
+extern "C"
+{
+    #include <3ds.h>
+}
+#endif
+
+#define ACM_PREFETCH_STACK_SIZE (16 * 1024)
+
+// host builds have no worker, files are always reset in place
+#ifdef _3DS
+/// File played after file, following the loop if the stream has one.
+static int get_next_file(VGMSTREAM* vgmstream, int file)
+{
+    mus_acm_codec_data* data = static_cast<mus_acm_codec_data*>(vgmstream->codec_data);
+    if (vgmstream->loop_flag && file + 1 == data->loop_end_file)
+        return data->loop_start_file;
+    return file + 1 < data->file_count ? file + 1 : 0;
+}
+
+struct acm_prefetch
+{
+    mus_acm_codec_data* data;
+    Thread thread;
+    LightLock lock;
+    /// Signaled when a file is asked for or the worker has to stop.
+    LightEvent work;
+    /// Signaled when the worker is done with a file.
+    LightEvent idle;
+
+    /// Everything below is guarded by lock.
+    bool stop;
+    /// File to prime next, being primed and primed, -1 for none.
+    int requested;
+    int priming;
+    int primed;
+};
+
+static void prefetch_main(void* arg)
+{
+    acm_prefetch* prefetch = static_cast<acm_prefetch*>(arg);
+
+    LightLock_Lock(&prefetch->lock);
+    while (!prefetch->stop)
+    {
+        if (prefetch->requested < 0)
+        {
+            LightLock_Unlock(&prefetch->lock);
+            LightEvent_Wait(&prefetch->work);
+            LightLock_Lock(&prefetch->lock);
+            continue;
+        }
+
+        int file = prefetch->requested;
+        prefetch->requested = -1;
+        prefetch->priming = file;
+        LightLock_Unlock(&prefetch->lock);
+
+        ACMStream* acm = prefetch->data->files[file];
+        uint8_t dummy[2];
+        acm_reset(acm);
+        // reading nothing still decodes the first block
+        acm_read(acm, dummy, 0, 0, 2, 1);
+
+        LightLock_Lock(&prefetch->lock);
+        prefetch->priming = -1;
+        prefetch->primed = file;
+        LightEvent_Signal(&prefetch->idle);
+    }
+    LightLock_Unlock(&prefetch->lock);
+}
+
+/// Asks for file to be primed unless it's being played or already is.
+static void request_file(acm_prefetch* prefetch, int file)
+{
+    LightLock_Lock(&prefetch->lock);
+    if (file != prefetch->data->current_file && file != prefetch->primed && file != prefetch->priming)
+        prefetch->requested = file;
+    LightLock_Unlock(&prefetch->lock);
+    LightEvent_Signal(&prefetch->work);
+}
+
+acm_prefetch* acm_prefetch_open(VGMSTREAM* vgmstream)
+{
+    mus_acm_codec_data* data = static_cast<mus_acm_codec_data*>(vgmstream->codec_data);
+    if (vgmstream->layout_type != layout_mus_acm || data->file_count < 2)
+        return NULL;
+
+    acm_prefetch* prefetch = new acm_prefetch();
+    prefetch->data = data;
+    LightLock_Init(&prefetch->lock);
+    LightEvent_Init(&prefetch->work, RESET_ONESHOT);
+    LightEvent_Init(&prefetch->idle, RESET_ONESHOT);
+    prefetch->stop = false;
+    prefetch->requested = -1;
+    prefetch->priming = -1;
+    prefetch->primed = -1;
+
+    // same cores as the NWA worker, the decoding thread's core gains nothing from it
+    s32 prio = 0;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    prefetch->thread = threadCreate(prefetch_main, prefetch, ACM_PREFETCH_STACK_SIZE, prio, 2, false);
+    if (!prefetch->thread)
+        prefetch->thread = threadCreate(prefetch_main, prefetch, ACM_PREFETCH_STACK_SIZE, prio, 1, false);
+    if (!prefetch->thread)
+    {
+        delete prefetch;
+        return NULL;
+    }
+
+    request_file(prefetch, get_next_file(vgmstream, data->current_file));
+    return prefetch;
+}
+
+void acm_prefetch_close(acm_prefetch* prefetch)
+{
+    if (!prefetch)
+        return;
+
+    LightLock_Lock(&prefetch->lock);
+    prefetch->stop = true;
+    LightLock_Unlock(&prefetch->lock);
+    LightEvent_Signal(&prefetch->work);
+    threadJoin(prefetch->thread, U64_MAX);
+    threadFree(prefetch->thread);
+    delete prefetch;
+}
+#else
+acm_prefetch* acm_prefetch_open(VGMSTREAM* vgmstream)
+{
+    return NULL;
+}
+
+void acm_prefetch_close(acm_prefetch* prefetch)
+{
+}
+#endif
+
+void acm_prefetch_switch(acm_prefetch* prefetch, VGMSTREAM* vgmstream, int file)
+{
+    mus_acm_codec_data* data = static_cast<mus_acm_codec_data*>(vgmstream->codec_data);
+    if (!prefetch)
+    {
+        data->current_file = file;
+        acm_reset(data->files[file]);
+        return;
+    }
+
+#ifdef _3DS
+    LightLock_Lock(&prefetch->lock);
+    // the worker must be done with whatever it has before a file gets played
+    prefetch->requested = -1;
+    while (prefetch->priming >= 0)
+    {
+        LightLock_Unlock(&prefetch->lock);
+        LightEvent_Wait(&prefetch->idle);
+        LightLock_Lock(&prefetch->lock);
+    }
+    data->current_file = file;
+    bool primed = prefetch->primed == file;
+    if (primed)
+        prefetch->primed = -1;
+    LightLock_Unlock(&prefetch->lock);
+
+    if (!primed)
+        acm_reset(data->files[file]);
+    request_file(prefetch, get_next_file(vgmstream, file));
+#endif
+}
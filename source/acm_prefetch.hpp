@@ -0,0 +1,32 @@
+#ifndef ACM_PREFETCH_HPP
+#define ACM_PREFETCH_HPP
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+/** Primes the next file of a multi file ACM (MUS) stream on a worker thread.
+  * Every file is opened up front by libvgmstream but starts with an
+  * acm_reset and a first block decode, which would otherwise land on the
+  * decoding thread right at the file boundary. Primed files are reset and
+  * have their first block decoded, the state acm_read leaves them in after
+  * reading nothing.
+  */
+struct acm_prefetch;
+
+/** Starts a worker for vgmstream (layout_mus_acm) and has it prime the file after the current one.
+  * Returns NULL if there's nothing to prime or the thread couldn't be started.
+  */
+acm_prefetch* acm_prefetch_open(VGMSTREAM* vgmstream);
+
+/// Stops the worker, NULL is ignored.
+void acm_prefetch_close(acm_prefetch* prefetch);
+
+/** Moves vgmstream on to file, what render_vgmstream_mus_acm does with acm_reset.
+  * A primed file is taken as is, anything else is reset here. The file after
+  * it is primed in the background. prefetch may be NULL.
+  */
+void acm_prefetch_switch(acm_prefetch* prefetch, VGMSTREAM* vgmstream, int file);
+
+#endif
@@ -0,0 +1,96 @@
+#include "adx_keyed.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <strings.h>
+
+extern "C"
+{
+    #include <coding/coding.h>
+}
+
+VGMSTREAM* init_vgmstream_adx_keyed(STREAMFILE* streamfile, coding_t coding_type, const uint16_t* key)
+{
+    char filename[PATH_LIMIT];
+    streamfile->get_name(streamfile, filename, sizeof(filename));
+    if (strcasecmp("adx", filename_extension(filename)))
+        return NULL;
+
+    if (static_cast<uint16_t>(read_16bitBE(0x00, streamfile)) != 0x8000)
+        return NULL;
+    int32_t stream_offset = static_cast<uint16_t>(read_16bitBE(0x02, streamfile)) + 4;
+    if (read_16bitBE(stream_offset - 6, streamfile) != 0x2863) // "(c"
+        return NULL;
+    if (read_32bitBE(stream_offset - 4, streamfile) != 0x29435249) // ")CRI"
+        return NULL;
+    // encoding type, frame size, bits per sample
+    if (read_8bit(0x04, streamfile) != 3 || read_8bit(0x05, streamfile) != 18 || read_8bit(0x06, streamfile) != 4)
+        return NULL;
+    // version and encryption flags
+    int16_t version = read_16bitBE(0x12, streamfile);
+    if (version != (coding_type == coding_CRI_ADX_enc_8 ? 0x0408 : 0x0409))
+        return NULL;
+
+    int32_t ainf_info_length = 0;
+    if (read_32bitBE(0x24, streamfile) == 0x41494E46) // "AINF"
+        ainf_info_length = read_32bitBE(0x28, streamfile);
+    int loop_flag = 0;
+    int32_t loop_start_sample = 0;
+    int32_t loop_end_sample = 0;
+    if (stream_offset - ainf_info_length - 6 >= 0x38)
+    {
+        int32_t loop_type = read_32bitBE(0x24, streamfile);
+        loop_flag = loop_type != static_cast<int32_t>(0xFFFEFFFE) && loop_type != 0;
+        loop_start_sample = read_32bitBE(0x28, streamfile);
+        loop_end_sample = read_32bitBE(0x30, streamfile);
+    }
+    uint16_t cutoff = read_16bitBE(0x10, streamfile);
+    if (loop_start_sample == 0 && loop_end_sample == 0)
+        loop_flag = 0;
+
+    int channel_count = read_8bit(0x07, streamfile);
+    VGMSTREAM* vgmstream = allocate_vgmstream(channel_count, loop_flag);
+    if (!vgmstream)
+        return NULL;
+    vgmstream->num_samples = read_32bitBE(0x0C, streamfile);
+    vgmstream->sample_rate = read_32bitBE(0x08, streamfile);
+    vgmstream->coding_type = coding_type;
+    vgmstream->layout_type = channel_count == 1 ? layout_none : layout_interleave;
+    vgmstream->interleave_block_size = 18;
+    vgmstream->loop_start_sample = loop_start_sample;
+    vgmstream->loop_end_sample = loop_end_sample;
+    vgmstream->meta_type = meta_ADX_04;
+
+    // same expressions as the meta so the coefficients come out the same
+    double x = cutoff;
+    double y = vgmstream->sample_rate;
+    double z = cos(2.0 * M_PI * x / y);
+    double a = M_SQRT2 - z;
+    double b = M_SQRT2 - 1.0;
+    double c = (a - sqrt((a + b) * (a - b))) / b;
+    int16_t coef1 = static_cast<int>(floor(c * 8192));
+    int16_t coef2 = static_cast<int>(floor(c * c * -4096));
+
+    STREAMFILE* file = streamfile->open(streamfile, filename, 18 * 0x400);
+    if (!file)
+    {
+        close_vgmstream(vgmstream);
+        return NULL;
+    }
+    for (int i = 0; i < channel_count; i++)
+    {
+        VGMSTREAMCHANNEL* ch = &vgmstream->ch[i];
+        ch->streamfile = file;
+        ch->channel_start_offset = ch->offset = stream_offset + 18 * i;
+        ch->adpcm_coef[0] = coef1;
+        ch->adpcm_coef[1] = coef2;
+        ch->adx_channels = channel_count;
+        ch->adx_xor = key[0];
+        ch->adx_mult = key[1];
+        ch->adx_add = key[2];
+        // each channel's frames come after the previous one's in the key sequence
+        for (int j = 0; j < i; j++)
+            adx_next_key(ch);
+    }
+    return vgmstream;
+}
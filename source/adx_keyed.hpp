@@ -0,0 +1,18 @@
+#ifndef ADX_KEYED_HPP
+#define ADX_KEYED_HPP
+
+#include <stdint.h>
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+/** Mirrors init_vgmstream_adx for an encrypted file whose key is already known,
+  * minus find_key, which reads through every frame of the file to test its key tables.
+  * key is the xor, mult and add the library's find_key settled on (vgmstream_info::adx_key).
+  * Encrypted files always have a type 04 header, NULL for anything else or another encryption type.
+  */
+VGMSTREAM* init_vgmstream_adx_keyed(STREAMFILE* streamfile, coding_t coding_type, const uint16_t* key);
+
+#endif
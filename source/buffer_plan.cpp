@@ -0,0 +1,51 @@
+#include "buffer_plan.hpp"
+
+#include <algorithm>
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+#include "playback_arena.hpp"
+
+/// Longest a buffer may play, also how long seeking and pausing take to be heard.
+#define BUFFER_PLAN_LATENCY_MS 1500
+/// Shortest a buffer should play for decoding the next one to keep up, per decode_cost.
+#define BUFFER_PLAN_LIGHT_FLOOR_MS 250
+#define BUFFER_PLAN_HEAVY_FLOOR_MS 500
+/// Samples are planned in steps of this, the least that is ever planned.
+#define BUFFER_PLAN_GRANULARITY 1024
+
+static uint32_t ms_to_samples(int32_t sample_rate, int ms)
+{
+    return static_cast<uint64_t>(sample_rate) * ms / 1000;
+}
+
+bool plan_buffers(const buffer_plan_request* request, buffer_plan* plan)
+{
+    if (request->channels <= 0 || request->sample_rate <= 0)
+        return false;
+
+    // the latency limits are rounded up to a granule, low sample rates would otherwise get nothing
+    uint32_t samples = std::min<uint32_t>(request->max_samples, ms_to_samples(request->sample_rate, BUFFER_PLAN_LATENCY_MS));
+    samples = std::max<uint32_t>(samples - samples % BUFFER_PLAN_GRANULARITY, BUFFER_PLAN_GRANULARITY);
+
+    // every buffer gets the same share, rounded so the arena's alignment comes out of it
+    const size_t frame_size = request->channels * sizeof(sample);
+    const int buffers = request->scratch ? 3 : 2;
+    size_t share = (request->available / buffers) & ~static_cast<size_t>(PLAYBACK_ARENA_ALIGNMENT - 1);
+    size_t fitting = share / frame_size;
+    fitting -= fitting % BUFFER_PLAN_GRANULARITY;
+    // only memory can make it fail
+    if (fitting == 0)
+        return false;
+    samples = std::min<uint64_t>(samples, fitting);
+
+    int floor_ms = request->cost == DECODE_COST_HEAVY ? BUFFER_PLAN_HEAVY_FLOOR_MS : BUFFER_PLAN_LIGHT_FLOOR_MS;
+    plan->samples = samples;
+    plan->buffer_size = samples * frame_size;
+    plan->scratch_size = request->scratch ? plan->buffer_size : 0;
+    plan->degraded = samples < std::min(request->max_samples, ms_to_samples(request->sample_rate, floor_ms));
+    return true;
+}
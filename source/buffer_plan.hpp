@@ -0,0 +1,49 @@
+#ifndef BUFFER_PLAN_HPP
+#define BUFFER_PLAN_HPP
+
+#include <cstddef>
+#include <stdint.h>
+
+/// How expensive a stream is to decode, costly ones get longer buffers to ride out slow buffers.
+enum decode_cost
+{
+    /// PCM and ADPCM the player decodes per channel.
+    DECODE_COST_LIGHT,
+    /// Transform codecs and whatever is left to render_vgmstream.
+    DECODE_COST_HEAVY,
+};
+
+struct buffer_plan_request
+{
+    int channels;
+    int32_t sample_rate;
+    decode_cost cost;
+    /// Whether render_planar needs its interleaved scratch buffer for the stream.
+    bool scratch;
+    /// Bytes the buffers may take up, see playback_arena_available.
+    size_t available;
+    /// Upper bound on the samples per buffer, like the latency limit it's rounded up to the smallest buffers.
+    uint32_t max_samples;
+};
+
+/** Sizes of the two playback buffers the player alternates between and the scratch buffer.
+  * Each one is a single playback_arena_alloc, sizes are in bytes.
+  */
+struct buffer_plan
+{
+    /// Samples per channel decoded into a buffer at once.
+    uint32_t samples;
+    size_t buffer_size;
+    /// 0 if the stream doesn't need scratch.
+    size_t scratch_size;
+    /// samples had to drop below what the cost class needs to not run dry.
+    bool degraded;
+};
+
+/** Picks the largest buffers within request's memory and latency limits,
+  * dropping below the underrun floor of the cost class if memory is short.
+  * Returns false if even the smallest buffers don't fit, memory is the only limit that can fail it.
+  */
+bool plan_buffers(const buffer_plan_request* request, buffer_plan* plan);
+
+#endif
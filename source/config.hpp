@@ -2,12 +2,28 @@
 #define CONFIG_H
 
 #include <string>
+#include <sys/types.h>
 #include <3ds.h>
 
 /// Directory to fetch music files from on sd card.
 const std::string music_directory = "/music";
 
+/// Remembers which meta opened each file so detection can be skipped next time.
+const std::string probe_cache_file = "/3ds/3ds-vgmstream/probe_cache.bin";
+
+/// What the library indexer found last time, shown right away on the next start.
+const std::string library_index_file = "/3ds/3ds-vgmstream/library.bin";
+
+/// Seconds left and right skip back and ahead while playing.
+const int seek_seconds = 10;
+
 /// Maximum number of samples to get at once
 u32 max_samples = 65536;
 
+/// Linear memory reserved at start-up for the playback buffers of every song.
+const u32 playback_arena_budget = 4 * 1024 * 1024;
+
+/// Files up to this size are read into memory in one go instead of streamed.
+const off_t memory_streamfile_limit = 2 * 1024 * 1024;
+
 #endif
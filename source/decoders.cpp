@@ -0,0 +1,878 @@
+#include "decoders.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__ARM_FEATURE_SIMD32) && defined(__ARM_FEATURE_SAT)
+#include <arm_acle.h>
+#define DECODERS_HAVE_SIMD32
+#endif
+
+extern "C"
+{
+    #include <coding/coding.h>
+}
+
+#include "acm_prefetch.hpp"
+#include "nwa_prefetch.hpp"
+#include "streamfile_ext.hpp"
+
+#define DSP_FRAME_SIZE 8
+#define DSP_FRAME_SAMPLES 14
+/// Frames fetched from the streamfile at once.
+#define DSP_FETCH_FRAMES 64
+#define ADX_FRAME_SIZE 18
+#define ADX_FRAME_SAMPLES 32
+#define ADX_FETCH_FRAMES 64
+/// Bytes of pcm fetched from the streamfile at once.
+#define PCM_FETCH_SIZE 0x400
+/// Bytes of G.721 codewords fetched from the streamfile at once.
+#define G721_FETCH_SIZE 0x200
+/// Interleaved ACM samples decoded at once before they're split up.
+#define ACM_DECODE_SAMPLES 0x200
+/// Bytes of HCA blocks read from the streamfile at once, at least one block.
+#define HCA_FETCH_SIZE 0x4000
+
+/** Returns size bytes at offset, peeked if possible or read into buffer otherwise.
+  * Bytes past the end of the file come back as 0xFF, what read_8bit gives the library decoders.
+  */
+static const uint8_t* fetch(STREAMFILE* streamfile, off_t offset, size_t size, uint8_t* buffer)
+{
+    const uint8_t* data = peek_streamfile(streamfile, offset, size);
+    if (data)
+        return data;
+
+    memset(buffer, 0xFF, size);
+    read_streamfile(buffer, offset, size, streamfile);
+    return buffer;
+}
+
+/** fetch for frames of frame_size bytes that start with a 16 bit field. The library
+  * decoders read that field with read_16bitBE/LE, which fails as a whole when the end
+  * of the file cuts the field in two, so a cut off field comes back as 0xFFFF too.
+  */
+static const uint8_t* fetch_frames(STREAMFILE* streamfile, off_t offset, size_t size, uint8_t* buffer, size_t frame_size)
+{
+    const uint8_t* data = peek_streamfile(streamfile, offset, size);
+    if (data)
+        return data;
+
+    memset(buffer, 0xFF, size);
+    size_t read = read_streamfile(buffer, offset, size, streamfile);
+    if (read < size && read % frame_size == 1)
+        buffer[read - 1] = 0xFF;
+    return buffer;
+}
+
+static inline int get_nibble(const uint8_t* data, int i)
+{
+    int8_t byte = data[i / 2];
+    return i & 1 ? static_cast<int8_t>(byte << 4) >> 4 : byte >> 4;
+}
+
+void decode_ngc_dsp_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do)
+{
+    uint8_t buffer[DSP_FETCH_FRAMES * DSP_FRAME_SIZE];
+    int frame = first_sample / DSP_FRAME_SAMPLES;
+    int i = first_sample % DSP_FRAME_SAMPLES;
+#ifdef DECODERS_HAVE_SIMD32
+    // hist1 in the low half, hist2 in the high half so one SMLAD does both taps
+    uint32_t hists = static_cast<uint16_t>(stream->adpcm_history1_16) | static_cast<uint32_t>(stream->adpcm_history2_16) << 16;
+#else
+    int32_t hist1 = stream->adpcm_history1_16;
+    int32_t hist2 = stream->adpcm_history2_16;
+#endif
+
+    while (samples_to_do > 0)
+    {
+        int frames = std::min((i + samples_to_do + DSP_FRAME_SAMPLES - 1) / DSP_FRAME_SAMPLES, DSP_FETCH_FRAMES);
+        const uint8_t* data = fetch(stream->streamfile, stream->offset + frame * DSP_FRAME_SIZE, frames * DSP_FRAME_SIZE, buffer);
+        frame += frames;
+
+        for (int f = 0; f < frames; f++, data += DSP_FRAME_SIZE)
+        {
+            int header = data[0];
+            int32_t scale = 1 << (header & 0xf);
+            // not range checked, same as decode_ngc_dsp
+            int coef_index = (header >> 4) & 0xf;
+            int32_t coef1 = stream->adpcm_coef[coef_index * 2];
+            int32_t coef2 = stream->adpcm_coef[coef_index * 2 + 1];
+            int end = std::min(DSP_FRAME_SAMPLES, i + samples_to_do);
+            samples_to_do -= end - i;
+
+#ifdef DECODERS_HAVE_SIMD32
+            int16x2_t coefs = static_cast<uint16_t>(coef1) | static_cast<uint32_t>(coef2) << 16;
+            for (; i < end; i++)
+            {
+                int32_t out = __ssat(__smlad(coefs, hists, ((get_nibble(data + 1, i) * scale) << 11) + 1024) >> 11, 16);
+                hists = static_cast<uint16_t>(out) | hists << 16;
+                *outbuf++ = out;
+            }
+#else
+            for (; i < end; i++)
+            {
+                int32_t out = clamp16((((get_nibble(data + 1, i) * scale) << 11) + 1024 + coef1 * hist1 + coef2 * hist2) >> 11);
+                hist2 = hist1;
+                hist1 = out;
+                *outbuf++ = out;
+            }
+#endif
+            i = 0;
+        }
+    }
+
+#ifdef DECODERS_HAVE_SIMD32
+    stream->adpcm_history1_16 = static_cast<int16_t>(hists);
+    stream->adpcm_history2_16 = static_cast<int16_t>(hists >> 16);
+#else
+    stream->adpcm_history1_16 = hist1;
+    stream->adpcm_history2_16 = hist2;
+#endif
+}
+
+/// Scales of unencrypted ADX frames.
+struct adx_scales
+{
+    int32_t scale(int raw) const { return static_cast<int16_t>(raw) + 1; }
+    void next_frame() {}
+};
+
+/// Scales of encrypted ADX frames, the key steps once per channel after every frame like decode_adx_enc does.
+struct adx_enc_scales
+{
+    VGMSTREAMCHANNEL* stream;
+
+    int32_t scale(int raw) const { return ((raw ^ stream->adx_xor) & 0x1FFF) + 1; }
+    void next_frame()
+    {
+        for (int i = 0; i < stream->adx_channels; i++)
+            adx_next_key(stream);
+    }
+};
+
+/// decode_adx and decode_adx_enc over whole runs of frames, scales tells the two apart.
+template <typename scale_reader>
+static void decode_adx_runs(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do, scale_reader scales)
+{
+    uint8_t buffer[ADX_FETCH_FRAMES * ADX_FRAME_SIZE];
+    int frame = first_sample / ADX_FRAME_SAMPLES;
+    int i = first_sample % ADX_FRAME_SAMPLES;
+    // the coefficients init_vgmstream_adx derived from the cutoff frequency
+    const int32_t coef1 = stream->adpcm_coef[0];
+    const int32_t coef2 = stream->adpcm_coef[1];
+    int32_t hist1 = stream->adpcm_history1_32;
+    int32_t hist2 = stream->adpcm_history2_32;
+
+    while (samples_to_do > 0)
+    {
+        int frames = std::min((i + samples_to_do + ADX_FRAME_SAMPLES - 1) / ADX_FRAME_SAMPLES, ADX_FETCH_FRAMES);
+        const uint8_t* data = fetch_frames(stream->streamfile, stream->offset + frame * ADX_FRAME_SIZE, frames * ADX_FRAME_SIZE, buffer, ADX_FRAME_SIZE);
+        frame += frames;
+
+        for (int f = 0; f < frames; f++, data += ADX_FRAME_SIZE)
+        {
+            int32_t scale = scales.scale(data[0] << 8 | data[1]);
+            int end = std::min(ADX_FRAME_SAMPLES, i + samples_to_do);
+            samples_to_do -= end - i;
+
+            for (; i < end; i++)
+            {
+                int32_t out = clamp16(get_nibble(data + 2, i) * scale + ((coef1 * hist1 + coef2 * hist2) >> 12));
+                hist2 = hist1;
+                hist1 = out;
+                *outbuf++ = out;
+            }
+            if (i == ADX_FRAME_SAMPLES)
+                scales.next_frame();
+            i = 0;
+        }
+    }
+
+    stream->adpcm_history1_32 = hist1;
+    stream->adpcm_history2_32 = hist2;
+}
+
+void decode_adx_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do)
+{
+    decode_adx_runs(stream, outbuf, first_sample, samples_to_do, adx_scales());
+}
+
+void decode_adx_enc_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do)
+{
+    decode_adx_runs(stream, outbuf, first_sample, samples_to_do, adx_enc_scales{stream});
+}
+
+/// Reads pcm samples of sample_size bytes in runs and converts them with convert.
+template <int sample_size, typename converter>
+static void decode_pcm_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do, converter convert)
+{
+    uint8_t buffer[PCM_FETCH_SIZE];
+    off_t offset = stream->offset + first_sample * sample_size;
+    while (samples_to_do > 0)
+    {
+        int samples = std::min(samples_to_do, PCM_FETCH_SIZE / sample_size);
+        const uint8_t* data = fetch_frames(stream->streamfile, offset, samples * sample_size, buffer, sample_size);
+        for (int i = 0; i < samples; i++, data += sample_size)
+            *outbuf++ = convert(data);
+        offset += samples * sample_size;
+        samples_to_do -= samples;
+    }
+}
+
+void decode_pcm16LE_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do)
+{
+    decode_pcm_frames<2>(stream, outbuf, first_sample, samples_to_do,
+        [](const uint8_t* data) { return static_cast<sample>(data[0] | data[1] << 8); });
+}
+
+void decode_pcm16BE_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do)
+{
+    decode_pcm_frames<2>(stream, outbuf, first_sample, samples_to_do,
+        [](const uint8_t* data) { return static_cast<sample>(data[0] << 8 | data[1]); });
+}
+
+void decode_pcm8_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do)
+{
+    decode_pcm_frames<1>(stream, outbuf, first_sample, samples_to_do,
+        [](const uint8_t* data) { return static_cast<sample>(data[0] << 8); });
+}
+
+/** G.721 codeword tables from g72x: log of the quantized difference, step size
+  * weight (before its << 5) and speed weight, side by side since each codeword uses all three.
+  */
+static const struct
+{
+    int16_t dqln;
+    int16_t wi;
+    int16_t fi;
+} g721_codewords[16] =
+{
+    {-2048, -12, 0x000}, {4, 18, 0x000}, {135, 41, 0x000}, {213, 64, 0x200},
+    {273, 112, 0x200}, {323, 198, 0x200}, {373, 355, 0x600}, {425, 1122, 0xE00},
+    {425, 1122, 0xE00}, {373, 355, 0x600}, {323, 198, 0x200}, {273, 112, 0x200},
+    {213, 64, 0x200}, {135, 41, 0x000}, {4, 18, 0x000}, {-2048, -12, 0x000},
+};
+
+/** g72x_state reordered for decode_g721_frames, the predictor coefficients and the
+  * history they're applied to, which every sample goes through, come first.
+  * The values are g72x_state's. Its shorts keep their 16 bits so the arithmetic
+  * wraps the same way, yl is 32 bits like long on the 3DS, and pk (short) and
+  * td (char), which only ever hold 0 or 1, are narrowed to bytes.
+  */
+struct g721_state
+{
+    int16_t b[6];
+    int16_t dq[6];
+    int16_t a[2];
+    int16_t sr[2];
+    int16_t yu;
+    int16_t ap;
+    int16_t dms;
+    int16_t dml;
+    int32_t yl;
+    uint8_t pk[2];
+    uint8_t td;
+};
+
+/// quan(value, power2, 15) from g72x, the bits value takes up but at most 15.
+static inline int g721_log2(int value)
+{
+    return value > 0 ? std::min(32 - __builtin_clz(value), 15) : 0;
+}
+
+/// Multiplies coefficient an by srn in g72x's floating point format, fmult from g72x.
+static inline int g721_fmult(int an, int srn)
+{
+    int anmag = an > 0 ? an : (-an) & 0x1FFF;
+    int anexp = g721_log2(anmag) - 6;
+    int anmant = anmag == 0 ? 32 : anexp >= 0 ? anmag >> anexp : anmag << -anexp;
+    int wanexp = anexp + ((srn >> 6) & 0xF) - 13;
+    int wanmant = (anmant * (srn & 0x3F) + 0x30) >> 4;
+    int retval = wanexp >= 0 ? (wanmant << wanexp) & 0x7FFF : wanmant >> -wanexp;
+    return (an ^ srn) < 0 ? -retval : retval;
+}
+
+/// value in g72x's floating point format, 4 bits exponent and 6 bits mantissa with the sign at 0x400.
+static inline int16_t g721_to_float(int value)
+{
+    if (value == 0)
+        return 0x20;
+    if (value > 0)
+    {
+        int exp = g721_log2(value);
+        return (exp << 6) + ((value << 6) >> exp);
+    }
+    if (value <= -0x8000)
+        return static_cast<int16_t>(0xFC20);
+    int exp = g721_log2(-value);
+    return (exp << 6) + ((-value << 6) >> exp) - 0x400;
+}
+
+/// update from g72x for 4 bit codewords.
+static inline void g721_update(g721_state* state, int y, int wi, int fi, int dq, int sr, int dqsez)
+{
+    const int pk0 = dqsez < 0;
+    const int mag = dq & 0x7FFF;
+
+    // transition detect
+    int ylint = static_cast<int16_t>(state->yl >> 15);
+    int thr = ylint > 9 ? 31 << 10 : static_cast<int16_t>((32 + ((state->yl >> 10) & 0x1F)) << ylint);
+    const int dqthr = static_cast<int16_t>((thr + (thr >> 1)) >> 1);
+    const bool tr = state->td && mag > dqthr;
+
+    state->yu = std::min<int>(std::max<int>(static_cast<int16_t>(y + ((wi - y) >> 5)), 544), 5120);
+    state->yl += state->yu + ((-state->yl) >> 6);
+
+    int16_t a2p = state->a[1] - (state->a[1] >> 7);
+    if (tr)
+    {
+        memset(state->a, 0, sizeof(state->a));
+        memset(state->b, 0, sizeof(state->b));
+    }
+    else
+    {
+        const int pks1 = pk0 ^ state->pk[0];
+        if (dqsez != 0)
+        {
+            int16_t fa1 = pks1 ? state->a[0] : -state->a[0];
+            if (fa1 < -8191)
+                a2p -= 0x100;
+            else if (fa1 > 8191)
+                a2p += 0xFF;
+            else
+                a2p += fa1 >> 5;
+
+            if (pk0 ^ state->pk[1])
+                a2p = a2p <= -12160 ? -12288 : a2p >= 12416 ? 12288 : a2p - 0x80;
+            else
+                a2p = a2p <= -12416 ? -12288 : a2p >= 12160 ? 12288 : a2p + 0x80;
+        }
+        state->a[1] = a2p;
+
+        state->a[0] -= state->a[0] >> 8;
+        if (dqsez != 0)
+            state->a[0] += pks1 ? -192 : 192;
+        const int16_t a1ul = 15360 - a2p;
+        state->a[0] = std::min<int>(std::max<int>(state->a[0], -a1ul), a1ul);
+
+        for (int i = 0; i < 6; i++)
+        {
+            state->b[i] -= state->b[i] >> 8;
+            if (mag)
+                state->b[i] += (dq ^ state->dq[i]) >= 0 ? 128 : -128;
+        }
+    }
+
+    for (int i = 5; i > 0; i--)
+        state->dq[i] = state->dq[i - 1];
+    if (mag == 0)
+        state->dq[0] = dq >= 0 ? 0x20 : static_cast<int16_t>(0xFC20);
+    else
+        state->dq[0] = g721_to_float(mag) - (dq >= 0 ? 0 : 0x400);
+    state->sr[1] = state->sr[0];
+    state->sr[0] = g721_to_float(sr);
+    state->pk[1] = state->pk[0];
+    state->pk[0] = pk0;
+    state->td = !tr && a2p < -11776;
+
+    state->dms += (fi - state->dms) >> 5;
+    state->dml += ((fi << 2) - state->dml) >> 7;
+    if (tr)
+        state->ap = 256;
+    else if (y < 1536 || state->td || std::abs((state->dms << 2) - state->dml) >= (state->dml >> 3))
+        state->ap += (0x200 - state->ap) >> 4;
+    else
+        state->ap += (-state->ap) >> 4;
+}
+
+/// g721_decoder from g72x for codeword i.
+static inline sample g721_decode(g721_state* state, int i)
+{
+    int sezi = 0;
+    for (int k = 0; k < 6; k++)
+        sezi += g721_fmult(state->b[k] >> 2, state->dq[k]);
+    const int16_t sez = static_cast<int16_t>(sezi) >> 1;
+    const int16_t se = static_cast<int16_t>(sezi + g721_fmult(state->a[1] >> 2, state->sr[1]) + g721_fmult(state->a[0] >> 2, state->sr[0])) >> 1;
+
+    // step_size
+    int y = state->yu;
+    if (state->ap < 256)
+    {
+        y = state->yl >> 6;
+        int dif = state->yu - y;
+        int al = state->ap >> 2;
+        if (dif > 0)
+            y += (dif * al) >> 6;
+        else if (dif < 0)
+            y += (dif * al + 0x3F) >> 6;
+    }
+    y = static_cast<int16_t>(y);
+
+    // reconstruct
+    const auto& codeword = g721_codewords[i];
+    const int16_t dql = codeword.dqln + (y >> 2);
+    int16_t dq;
+    if (dql < 0)
+        dq = i & 8 ? -0x8000 : 0;
+    else
+    {
+        dq = ((128 + (dql & 127)) << 7) >> (14 - ((dql >> 7) & 15));
+        if (i & 8)
+            dq -= 0x8000;
+    }
+
+    const int16_t sr = dq < 0 ? se - (dq & 0x3FFF) : se + dq;
+    const int16_t dqsez = sr - se + sez;
+    g721_update(state, y, codeword.wi << 5, codeword.fi, dq, sr, dqsez);
+    return sr << 2;
+}
+
+void decode_g721_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do)
+{
+    const g72x_state& saved = stream->g72x_state;
+    g721_state state;
+    memcpy(state.b, saved.b, sizeof(state.b));
+    memcpy(state.dq, saved.dq, sizeof(state.dq));
+    memcpy(state.a, saved.a, sizeof(state.a));
+    memcpy(state.sr, saved.sr, sizeof(state.sr));
+    state.yu = saved.yu;
+    state.ap = saved.ap;
+    state.dms = saved.dms;
+    state.dml = saved.dml;
+    state.yl = saved.yl;
+    state.pk[0] = saved.pk[0];
+    state.pk[1] = saved.pk[1];
+    state.td = saved.td;
+
+    uint8_t buffer[G721_FETCH_SIZE];
+    int32_t i = first_sample;
+    const int32_t end = first_sample + samples_to_do;
+    while (i < end)
+    {
+        int32_t samples = std::min(end - i, G721_FETCH_SIZE * 2 - (i & 1));
+        const int32_t first_byte = i / 2;
+        const uint8_t* data = fetch(stream->streamfile, stream->offset + first_byte, (i + samples + 1) / 2 - first_byte, buffer);
+        // low nibble first
+        for (const int32_t n = i + samples; i < n; i++)
+            *outbuf++ = g721_decode(&state, (i & 1 ? data[i / 2 - first_byte] >> 4 : data[i / 2 - first_byte]) & 0xF);
+    }
+
+    g72x_state& out = stream->g72x_state;
+    memcpy(out.b, state.b, sizeof(state.b));
+    memcpy(out.dq, state.dq, sizeof(state.dq));
+    memcpy(out.a, state.a, sizeof(state.a));
+    memcpy(out.sr, state.sr, sizeof(state.sr));
+    out.yu = state.yu;
+    out.ap = state.ap;
+    out.dms = state.dms;
+    out.dml = state.dml;
+    out.yl = state.yl;
+    out.pk[0] = state.pk[0];
+    out.pk[1] = state.pk[1];
+    out.td = state.td;
+}
+
+#if defined(VGM_USE_VORBIS) && !defined(USE_TREMOR)
+/// vorbis_ftoi and the clamp in ov_read, the conversion truncates after adding .5 like it does on ARM.
+static inline sample float_to_sample(float value)
+{
+    double rounded = value * 32768.f + .5;
+    if (rounded >= 32767)
+        return 32767;
+    if (rounded <= -32768)
+        return -32768;
+    return static_cast<int32_t>(rounded);
+}
+
+void decode_ogg_vorbis_planar(VGMSTREAM* vgmstream, void* stream_data, sample** channels, int32_t samples_written, int32_t samples_to_do)
+{
+    ogg_vorbis_codec_data* data = static_cast<ogg_vorbis_codec_data*>(vgmstream->codec_data);
+    OggVorbis_File* file = &data->ogg_vorbis_file;
+    const int channel_count = std::min(ov_info(file, -1)->channels, vgmstream->channels);
+
+    int32_t samples_done = 0;
+    while (samples_done < samples_to_do)
+    {
+        float** pcm;
+        long samples = ov_read_float(file, &pcm, samples_to_do - samples_done, &data->bitstream);
+        if (samples <= 0)
+            break;
+
+        for (int chan = 0; chan < channel_count; chan++)
+        {
+            const float* in = pcm[chan];
+            sample* out = channels[chan] + samples_written + samples_done;
+            for (long i = 0; i < samples; i++)
+                out[i] = float_to_sample(in[i]);
+        }
+        samples_done += samples;
+    }
+
+    // decode_ogg_vorbis leaves the buffer as it was on errors, silence is better than stale samples
+    for (int chan = 0; chan < vgmstream->channels; chan++)
+    {
+        int32_t start = chan < channel_count ? samples_done : 0;
+        memset(channels[chan] + samples_written + start, 0, (samples_to_do - start) * sizeof(sample));
+    }
+}
+#endif
+
+/** Reads runs of HCA blocks ahead, kept from one decode call to the next as
+  * the stream data of decode_hca_planar. Blocks are handed out once and in order,
+  * clHCA_Decode unmasks encrypted blocks in place so they can't be reused.
+  */
+struct hca_block_reader
+{
+    STREAMFILE* streamfile;
+    size_t block_size;
+    std::vector<uint8_t> buffer;
+    /// File offset of the next block in buffer and the bytes read from there on.
+    off_t offset;
+    size_t valid;
+    uint8_t* next;
+};
+
+/// Blocks read at once, VBR files have no fixed block size and get read one at a time.
+static size_t get_hca_fetch_blocks(size_t block_size)
+{
+    return block_size ? std::max<size_t>(HCA_FETCH_SIZE / block_size, 1) : 1;
+}
+
+/// The block at offset, NULL if it couldn't be read in full like decode_hca's read.
+static uint8_t* read_hca_block(hca_block_reader* reader, off_t offset, unsigned int blocks_left)
+{
+    if (offset != reader->offset || reader->valid < reader->block_size)
+    {
+        size_t size = reader->block_size * std::min<size_t>(get_hca_fetch_blocks(reader->block_size), blocks_left);
+        if (reader->buffer.size() < size)
+            reader->buffer.resize(size);
+        reader->offset = offset;
+        reader->valid = read_streamfile(reader->buffer.data(), offset, size, reader->streamfile);
+        reader->next = reader->buffer.data();
+        if (reader->valid < reader->block_size)
+            return NULL;
+    }
+
+    uint8_t* block = reader->next;
+    reader->next += reader->block_size;
+    reader->offset += reader->block_size;
+    reader->valid -= reader->block_size;
+    return block;
+}
+
+/// Splits samples_to_do samples of the interleaved sample_buffer up into channels from pos on.
+static void copy_hca_samples(const sample* in, int channel_count, sample** channels, int32_t pos, int32_t samples_to_do)
+{
+    for (int chan = 0; chan < channel_count; chan++)
+    {
+        const sample* src = in + chan;
+        sample* out = channels[chan] + pos;
+        for (int32_t i = 0; i < samples_to_do; i++, src += channel_count)
+            out[i] = *src;
+    }
+}
+
+/** One decode_hca call, at most up to the end of the block. Keeps curblock,
+  * sample_ptr and samples_discard the way it does so looping still works.
+  */
+static void decode_hca_block(hca_codec_data* data, hca_block_reader* reader, int channel_count, sample** channels, int32_t pos, int32_t samples_to_do)
+{
+    clHCA* hca = reinterpret_cast<clHCA*>(data + 1);
+    int32_t samples_done = 0;
+
+    int32_t samples_remain = clHCA_samplesPerBlock - data->sample_ptr;
+    if (data->samples_discard)
+    {
+        if (static_cast<unsigned int>(samples_remain) <= data->samples_discard)
+        {
+            data->samples_discard -= samples_remain;
+            samples_remain = 0;
+        }
+        else
+        {
+            samples_remain -= data->samples_discard;
+            data->sample_ptr += data->samples_discard;
+            data->samples_discard = 0;
+        }
+    }
+    samples_remain = std::min(samples_remain, samples_to_do);
+    copy_hca_samples(data->sample_buffer + data->sample_ptr * data->info.channelCount, channel_count, channels, pos, samples_remain);
+    data->sample_ptr += samples_remain;
+    samples_done += samples_remain;
+
+    while (samples_done < samples_to_do)
+    {
+        if (data->curblock >= data->info.blockCount)
+        {
+            for (int chan = 0; chan < channel_count; chan++)
+                memset(channels[chan] + pos + samples_done, 0, (samples_to_do - samples_done) * sizeof(sample));
+            break;
+        }
+
+        unsigned int address = data->info.dataOffset + data->curblock * data->info.blockSize;
+        uint8_t* block = read_hca_block(reader, data->start + address, data->info.blockCount - data->curblock);
+        if (!block || clHCA_Decode(hca, block, data->info.blockSize, address) < 0)
+            break;
+        data->curblock++;
+        clHCA_DecodeSamples16(hca, data->sample_buffer);
+
+        samples_remain = clHCA_samplesPerBlock;
+        data->sample_ptr = 0;
+        if (data->samples_discard >= clHCA_samplesPerBlock)
+        {
+            data->samples_discard -= clHCA_samplesPerBlock;
+            samples_remain = 0;
+        }
+        else if (data->samples_discard)
+        {
+            samples_remain -= data->samples_discard;
+            data->samples_discard = 0;
+        }
+        samples_remain = std::min(samples_remain, samples_to_do - samples_done);
+        // decode_hca copies from the start of the block even after discarding part of it
+        copy_hca_samples(data->sample_buffer, channel_count, channels, pos + samples_done, samples_remain);
+        data->sample_ptr = samples_remain;
+        samples_done += samples_remain;
+    }
+}
+
+void decode_hca_planar(VGMSTREAM* vgmstream, void* stream_data, sample** channels, int32_t samples_written, int32_t samples_to_do)
+{
+    hca_codec_data* data = static_cast<hca_codec_data*>(vgmstream->codec_data);
+    hca_block_reader* reader = static_cast<hca_block_reader*>(stream_data);
+
+    // split up the way decode_vgmstream's callers do, a block at most per call
+    int32_t first_sample = vgmstream->samples_into_block;
+    while (samples_to_do > 0)
+    {
+        int32_t samples = std::min<int32_t>(samples_to_do, clHCA_samplesPerBlock - first_sample % clHCA_samplesPerBlock);
+        decode_hca_block(data, reader, vgmstream->channels, channels, samples_written, samples);
+        samples_written += samples;
+        first_sample += samples;
+        samples_to_do -= samples;
+    }
+}
+
+void* open_hca_reader(VGMSTREAM* vgmstream)
+{
+    hca_codec_data* data = static_cast<hca_codec_data*>(vgmstream->codec_data);
+    hca_block_reader* reader = new hca_block_reader();
+    reader->streamfile = data->streamfile;
+    reader->block_size = data->info.blockSize;
+    reader->buffer.reserve(get_hca_fetch_blocks(reader->block_size) * reader->block_size);
+    reader->offset = -1;
+    reader->valid = 0;
+    reader->next = NULL;
+    return reader;
+}
+
+void close_hca_reader(void* stream_data)
+{
+    delete static_cast<hca_block_reader*>(stream_data);
+}
+
+void decode_acm_planar(VGMSTREAM* vgmstream, void* stream_data, sample** channels, int32_t samples_written, int32_t samples_to_do)
+{
+    ACMStream* acm;
+    if (vgmstream->layout_type == layout_mus_acm)
+    {
+        mus_acm_codec_data* data = static_cast<mus_acm_codec_data*>(vgmstream->codec_data);
+        acm = data->files[data->current_file];
+    }
+    else
+    {
+        acm = static_cast<ACMStream*>(vgmstream->codec_data);
+    }
+
+    sample buffer[ACM_DECODE_SAMPLES];
+    const int channel_count = vgmstream->channels;
+    const int32_t max_samples = std::max(ACM_DECODE_SAMPLES / channel_count, 1);
+    while (samples_to_do > 0)
+    {
+        int32_t samples = std::min(samples_to_do, max_samples);
+        // decode_acm writes nothing past the end of the file
+        memset(buffer, 0, samples * channel_count * sizeof(sample));
+        decode_acm(acm, buffer, samples, channel_count);
+        for (int chan = 0; chan < channel_count; chan++)
+        {
+            const sample* in = buffer + chan;
+            sample* out = channels[chan] + samples_written;
+            for (int32_t i = 0; i < samples; i++, in += channel_count)
+                out[i] = *in;
+        }
+        samples_written += samples;
+        samples_to_do -= samples;
+    }
+}
+
+void* open_acm_prefetch(VGMSTREAM* vgmstream)
+{
+    return acm_prefetch_open(vgmstream);
+}
+
+void close_acm_prefetch(void* stream_data)
+{
+    acm_prefetch_close(static_cast<acm_prefetch*>(stream_data));
+}
+
+void decode_nwa_planar(VGMSTREAM* vgmstream, void* stream_data, sample** channels, int32_t samples_written, int32_t samples_to_do)
+{
+    NWAData* nwa = static_cast<nwa_codec_data*>(vgmstream->codec_data)->nwa;
+    nwa_prefetch* prefetch = static_cast<nwa_prefetch*>(stream_data);
+    const int channel_count = nwa->channels;
+
+    while (samples_to_do > 0)
+    {
+        if (nwa->samples_in_buffer <= 0)
+        {
+            nwa_prefetch_next_block(prefetch, nwa);
+            continue;
+        }
+
+        int32_t samples = std::min(nwa->samples_in_buffer / channel_count, samples_to_do);
+        for (int chan = 0; chan < vgmstream->channels; chan++)
+        {
+            const sample* in = nwa->buffer_readpos + chan;
+            sample* out = channels[chan] + samples_written;
+            for (int32_t i = 0; i < samples; i++, in += channel_count)
+                out[i] = *in;
+        }
+        nwa->buffer_readpos += samples * channel_count;
+        nwa->samples_in_buffer -= samples * channel_count;
+        samples_written += samples;
+        samples_to_do -= samples;
+    }
+}
+
+void* open_nwa_prefetch(VGMSTREAM* vgmstream)
+{
+    return nwa_prefetch_open(static_cast<nwa_codec_data*>(vgmstream->codec_data)->nwa);
+}
+
+void close_nwa_prefetch(void* stream_data)
+{
+    nwa_prefetch_close(static_cast<nwa_prefetch*>(stream_data));
+}
+
+/** Codings whose decoder only looks at its channel, so any of them can be driven
+  * by render_planar. Sample interleaved codings (the _int ones) aren't, their
+  * decoders use channelspacing to find their input. Neither is NDS IMA, its
+  * short frames don't have the same size as the others.
+  */
+static const struct
+{
+    coding_t coding;
+    planar_decoder planar;
+    channel_decoder channel;
+} frame_decoders[] =
+{
+    {coding_PCM16LE, decode_pcm16LE_frames, decode_pcm16LE},
+    {coding_PCM16BE, decode_pcm16BE_frames, decode_pcm16BE},
+    {coding_PCM8, decode_pcm8_frames, decode_pcm8},
+    {coding_PCM8_U, NULL, decode_pcm8_unsigned},
+    {coding_NGC_DSP, decode_ngc_dsp_frames, decode_ngc_dsp},
+    {coding_NGC_AFC, NULL, decode_ngc_afc},
+    {coding_CRI_ADX, decode_adx_frames, decode_adx},
+    {coding_CRI_ADX_enc_8, decode_adx_enc_frames, decode_adx_enc},
+    {coding_CRI_ADX_enc_9, decode_adx_enc_frames, decode_adx_enc},
+    {coding_G721, decode_g721_frames, decode_g721},
+    {coding_PSX, NULL, decode_psx},
+    {coding_invert_PSX, NULL, decode_invert_psx},
+    {coding_PSX_badflags, NULL, decode_psx_badflags},
+    {coding_FFXI, NULL, decode_ffxi_adpcm},
+    {coding_BAF_ADPCM, NULL, decode_baf_adpcm},
+    {coding_SDX2, NULL, decode_sdx2},
+    {coding_CBD2, NULL, decode_cbd2},
+    {coding_DVI_IMA, NULL, decode_dvi_ima},
+    {coding_IMA, NULL, decode_ima},
+    {coding_RAD_IMA_mono, NULL, decode_rad_ima_mono},
+    {coding_APPLE_IMA4, NULL, decode_apple_ima4},
+    {coding_DAT4_IMA, NULL, decode_dat4_ima},
+};
+
+/// Codings render_planar decodes all channels of at once.
+static const struct
+{
+    coding_t coding;
+    stream_decoder stream;
+    stream_decoder_open open;
+    stream_decoder_close close;
+} stream_decoders[] =
+{
+#if defined(VGM_USE_VORBIS) && !defined(USE_TREMOR)
+    {coding_ogg_vorbis, decode_ogg_vorbis_planar, NULL, NULL},
+#endif
+    {coding_CRI_HCA, decode_hca_planar, open_hca_reader, close_hca_reader},
+    {coding_ACM, decode_acm_planar, open_acm_prefetch, close_acm_prefetch},
+    {coding_NWA0, decode_nwa_planar, open_nwa_prefetch, close_nwa_prefetch},
+    {coding_NWA1, decode_nwa_planar, open_nwa_prefetch, close_nwa_prefetch},
+    {coding_NWA2, decode_nwa_planar, open_nwa_prefetch, close_nwa_prefetch},
+    {coding_NWA3, decode_nwa_planar, open_nwa_prefetch, close_nwa_prefetch},
+    {coding_NWA4, decode_nwa_planar, open_nwa_prefetch, close_nwa_prefetch},
+    {coding_NWA5, decode_nwa_planar, open_nwa_prefetch, close_nwa_prefetch},
+};
+
+bool get_frame_decoder(VGMSTREAM* vgmstream, frame_decoder* decoder)
+{
+    decoder->stream = NULL;
+    decoder->stream_data = NULL;
+    decoder->stream_close = NULL;
+    for (const auto& entry : stream_decoders)
+    {
+        if (entry.coding != vgmstream->coding_type)
+            continue;
+        decoder->stream = entry.stream;
+        if (entry.open)
+        {
+            decoder->stream_data = entry.open(vgmstream);
+            decoder->stream_close = entry.close;
+        }
+        decoder->planar = NULL;
+        decoder->channel = NULL;
+        decoder->samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+        return true;
+    }
+
+    for (const auto& entry : frame_decoders)
+    {
+        if (entry.coding != vgmstream->coding_type)
+            continue;
+        decoder->planar = entry.planar;
+        decoder->channel = entry.channel;
+        decoder->samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+        return true;
+    }
+    return false;
+}
+
+void close_frame_decoder(frame_decoder* decoder)
+{
+    if (decoder->stream_close)
+        decoder->stream_close(decoder->stream_data);
+    decoder->stream_data = NULL;
+    decoder->stream_close = NULL;
+}
+
+void decode_frames(const frame_decoder* decoder, VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do)
+{
+    if (decoder->planar)
+    {
+        decoder->planar(stream, outbuf, first_sample, samples_to_do);
+        return;
+    }
+
+    // same calls decode_vgmstream would make, only planar
+    const int samples_per_frame = decoder->samples_per_frame;
+    while (samples_to_do > 0)
+    {
+        int32_t samples = samples_to_do;
+        if (samples_per_frame > 1)
+            samples = std::min(samples, samples_per_frame - first_sample % samples_per_frame);
+        decoder->channel(stream, outbuf, 1, first_sample, samples);
+        outbuf += samples;
+        first_sample += samples;
+        samples_to_do -= samples;
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef DECODERS_HPP
+#define DECODERS_HPP
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+/** Player side decoders for the codecs render_planar decodes itself.
+  * They write planar output (channelspacing 1) and, unlike libvgmstream's,
+  * take any number of samples, not just up to the end of the current frame.
+  * Output is bit exact with the libvgmstream decoder they replace.
+  */
+typedef void (*planar_decoder)(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do);
+
+/// Signature of libvgmstream's decoders that only need their channel.
+typedef void (*channel_decoder)(VGMSTREAMCHANNEL* stream, sample* outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do);
+
+/** Player side decoders for codecs that decode every channel at once from the
+  * stream's codec data. They write samples_to_do samples to each of channels from samples_written on.
+  * stream_data is what the coding's stream_decoder_open returned, NULL if it has none.
+  */
+typedef void (*stream_decoder)(VGMSTREAM* vgmstream, void* stream_data, sample** channels, int32_t samples_written, int32_t samples_to_do);
+
+/// Optional per stream state of a stream_decoder, opened with the decoder and closed by close_frame_decoder.
+typedef void* (*stream_decoder_open)(VGMSTREAM* vgmstream);
+typedef void (*stream_decoder_close)(void* stream_data);
+
+/// How render_planar decodes a coding.
+struct frame_decoder
+{
+    /// Decodes all channels at once if not NULL, planar and channel aren't used then.
+    stream_decoder stream;
+    void* stream_data;
+    stream_decoder_close stream_close;
+    /// Player side decoder, NULL if the library one is used.
+    planar_decoder planar;
+    /// Library decoder, called for at most a frame at a time like decode_vgmstream does.
+    channel_decoder channel;
+    int samples_per_frame;
+};
+
+/** Looks up the decoder for vgmstream's coding. Returns false for codings
+  * whose decoder needs more than its channel (the whole VGMSTREAM, codec data or
+  * the channel count for sample interleaved data) and that have no stream_decoder,
+  * those are left to render_vgmstream.
+  */
+bool get_frame_decoder(VGMSTREAM* vgmstream, frame_decoder* decoder);
+
+/// Releases what get_frame_decoder opened for decoder, the stream must still be open.
+void close_frame_decoder(frame_decoder* decoder);
+
+/// Decodes samples_to_do samples from first_sample into the current block of stream with decoder.
+void decode_frames(const frame_decoder* decoder, VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do);
+
+/// decode_ngc_dsp over whole runs of frames, frame data is peeked when the streamfile allows it.
+void decode_ngc_dsp_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do);
+
+/// decode_adx and decode_adx_enc over whole runs of frames, the encryption key steps the same way.
+void decode_adx_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do);
+void decode_adx_enc_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do);
+
+/// decode_pcm16LE, decode_pcm16BE and decode_pcm8 reading runs of samples at once.
+void decode_pcm16LE_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do);
+void decode_pcm16BE_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do);
+void decode_pcm8_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do);
+
+/// decode_g721 on a reordered copy of the channel's g72x_state, codewords are fetched in runs.
+void decode_g721_frames(VGMSTREAMCHANNEL* stream, sample* outbuf, int32_t first_sample, int32_t samples_to_do);
+
+#if defined(VGM_USE_VORBIS) && !defined(USE_TREMOR)
+/// decode_ogg_vorbis with ov_read_float, converted straight into channels the way ov_read converts.
+void decode_ogg_vorbis_planar(VGMSTREAM* vgmstream, void* stream_data, sample** channels, int32_t samples_written, int32_t samples_to_do);
+#endif
+
+/** decode_hca deinterleaving straight into channels. Block data is read several
+  * blocks at a time into the buffer of the stream data from open_hca_reader.
+  */
+void decode_hca_planar(VGMSTREAM* vgmstream, void* stream_data, sample** channels, int32_t samples_written, int32_t samples_to_do);
+void* open_hca_reader(VGMSTREAM* vgmstream);
+void close_hca_reader(void* stream_data);
+
+/** decode_acm for the current file of the stream, split up into channels.
+  * For multi file streams the stream data from open_acm_prefetch primes the next file.
+  */
+void decode_acm_planar(VGMSTREAM* vgmstream, void* stream_data, sample** channels, int32_t samples_written, int32_t samples_to_do);
+void* open_acm_prefetch(VGMSTREAM* vgmstream);
+void close_acm_prefetch(void* stream_data);
+
+/** decode_nwa deinterleaving straight into channels. With stream data from
+  * open_nwa_prefetch upcoming blocks are decoded ahead on a worker thread.
+  */
+void decode_nwa_planar(VGMSTREAM* vgmstream, void* stream_data, sample** channels, int32_t samples_written, int32_t samples_to_do);
+void* open_nwa_prefetch(VGMSTREAM* vgmstream);
+void close_nwa_prefetch(void* stream_data);
+
+#endif
@@ -0,0 +1,549 @@
+#include "detect.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+
+extern "C"
+{
+    #include <coding/coding.h>
+    #include <meta/meta.h>
+}
+
+#include "adx_keyed.hpp"
+
+typedef VGMSTREAM* (*probe_fn)(STREAMFILE*);
+
+/// Every probe in the order init_vgmstream_internal tries them (its init_vgmstream_fcns table).
+/// The order decides which meta wins when several accept a file so it must be kept in sync with libvgmstream.
+static const probe_fn probe_table[] =
+{
+    init_vgmstream_adx,
+    init_vgmstream_brstm,
+    init_vgmstream_bfwav,
+    init_vgmstream_bfstm,
+    init_vgmstream_mca,
+    init_vgmstream_btsnd,
+    init_vgmstream_nds_strm,
+    init_vgmstream_agsc,
+    init_vgmstream_ngc_adpdtk,
+    init_vgmstream_rsf,
+    init_vgmstream_afc,
+    init_vgmstream_ast,
+    init_vgmstream_halpst,
+    init_vgmstream_rs03,
+    init_vgmstream_ngc_dsp_std,
+    init_vgmstream_ngc_dsp_csmp,
+    init_vgmstream_Cstr,
+    init_vgmstream_gcsw,
+    init_vgmstream_ps2_ads,
+    init_vgmstream_ps2_npsf,
+    init_vgmstream_rwsd,
+    init_vgmstream_cdxa,
+    init_vgmstream_ps2_rxw,
+    init_vgmstream_ps2_int,
+    init_vgmstream_ngc_dsp_stm,
+    init_vgmstream_ps2_exst,
+    init_vgmstream_ps2_svag,
+    init_vgmstream_ps2_mib,
+    init_vgmstream_ngc_mpdsp,
+    init_vgmstream_ps2_mic,
+    init_vgmstream_ngc_dsp_std_int,
+    init_vgmstream_raw,
+    init_vgmstream_ps2_vag,
+    init_vgmstream_psx_gms,
+    init_vgmstream_ps2_str,
+    init_vgmstream_ps2_ild,
+    init_vgmstream_ps2_pnb,
+    init_vgmstream_xbox_wavm,
+    init_vgmstream_xbox_xwav,
+    init_vgmstream_ngc_str,
+    init_vgmstream_ea,
+    init_vgmstream_caf,
+    init_vgmstream_ps2_vpk,
+    init_vgmstream_genh,
+    init_vgmstream_ogg_vorbis,
+    init_vgmstream_sli_ogg,
+    init_vgmstream_sfl,
+    init_vgmstream_sadb,
+    init_vgmstream_ps2_bmdx,
+    init_vgmstream_wsi,
+    init_vgmstream_aifc,
+    init_vgmstream_str_snds,
+    init_vgmstream_ws_aud,
+    init_vgmstream_ahx,
+    init_vgmstream_ivb,
+    init_vgmstream_amts,
+    init_vgmstream_svs,
+    init_vgmstream_riff,
+    init_vgmstream_rifx,
+    init_vgmstream_pos,
+    init_vgmstream_nwa,
+    init_vgmstream_eacs,
+    init_vgmstream_xss,
+    init_vgmstream_sl3,
+    init_vgmstream_hgc1,
+    init_vgmstream_aus,
+    init_vgmstream_rws,
+    init_vgmstream_fsb1,
+    init_vgmstream_fsb3,
+    init_vgmstream_fsb4,
+    init_vgmstream_fsb4_wav,
+    init_vgmstream_fsb5,
+    init_vgmstream_rwx,
+    init_vgmstream_xwb,
+    init_vgmstream_xwb2,
+    init_vgmstream_xa30,
+    init_vgmstream_musc,
+    init_vgmstream_musx_v004,
+    init_vgmstream_musx_v005,
+    init_vgmstream_musx_v006,
+    init_vgmstream_musx_v010,
+    init_vgmstream_musx_v201,
+    init_vgmstream_leg,
+    init_vgmstream_filp,
+    init_vgmstream_ikm,
+    init_vgmstream_sfs,
+    init_vgmstream_bg00,
+    init_vgmstream_dvi,
+    init_vgmstream_kcey,
+    init_vgmstream_ps2_rstm,
+    init_vgmstream_acm,
+    init_vgmstream_mus_acm,
+    init_vgmstream_ps2_kces,
+    init_vgmstream_ps2_dxh,
+    init_vgmstream_ps2_psh,
+    init_vgmstream_pcm_scd,
+    init_vgmstream_pcm_ps2,
+    init_vgmstream_ps2_rkv,
+    init_vgmstream_ps2_psw,
+    init_vgmstream_ps2_vas,
+    init_vgmstream_ps2_tec,
+    init_vgmstream_ps2_enth,
+    init_vgmstream_sdt,
+    init_vgmstream_aix,
+    init_vgmstream_ngc_tydsp,
+    init_vgmstream_ngc_swd,
+    init_vgmstream_capdsp,
+    init_vgmstream_xbox_wvs,
+    init_vgmstream_ngc_wvs,
+    init_vgmstream_dc_str,
+    init_vgmstream_dc_str_v2,
+    init_vgmstream_xbox_stma,
+    init_vgmstream_xbox_matx,
+    init_vgmstream_de2,
+    init_vgmstream_vs,
+    init_vgmstream_dc_str,
+    init_vgmstream_dc_str_v2,
+    init_vgmstream_xbox_xmu,
+    init_vgmstream_xbox_xvas,
+    init_vgmstream_ngc_bh2pcm,
+    init_vgmstream_sat_sap,
+    init_vgmstream_dc_idvi,
+    init_vgmstream_ps2_rnd,
+    init_vgmstream_wii_idsp,
+    init_vgmstream_kraw,
+    init_vgmstream_ps2_omu,
+    init_vgmstream_ps2_xa2,
+    init_vgmstream_idsp2,
+    init_vgmstream_idsp3,
+    init_vgmstream_idsp4,
+    init_vgmstream_ngc_ymf,
+    init_vgmstream_sadl,
+    init_vgmstream_ps2_ccc,
+    init_vgmstream_psx_fag,
+    init_vgmstream_ps2_mihb,
+    init_vgmstream_ngc_pdt,
+    init_vgmstream_wii_mus,
+    init_vgmstream_dc_asd,
+    init_vgmstream_naomi_spsd,
+    init_vgmstream_rsd2vag,
+    init_vgmstream_rsd2pcmb,
+    init_vgmstream_rsd2xadp,
+    init_vgmstream_rsd3vag,
+    init_vgmstream_rsd3gadp,
+    init_vgmstream_rsd3pcm,
+    init_vgmstream_rsd3pcmb,
+    init_vgmstream_rsd4pcmb,
+    init_vgmstream_rsd4pcm,
+    init_vgmstream_rsd4radp,
+    init_vgmstream_rsd4vag,
+    init_vgmstream_rsd6vag,
+    init_vgmstream_rsd6wadp,
+    init_vgmstream_rsd6xadp,
+    init_vgmstream_rsd6radp,
+    init_vgmstream_bgw,
+    init_vgmstream_spw,
+    init_vgmstream_ps2_ass,
+    init_vgmstream_waa_wac_wad_wam,
+    init_vgmstream_seg,
+    init_vgmstream_nds_strm_ffta2,
+    init_vgmstream_str_asr,
+    init_vgmstream_zwdsp,
+    init_vgmstream_gca,
+    init_vgmstream_spt_spd,
+    init_vgmstream_ish_isd,
+    init_vgmstream_gsp_gsb,
+    init_vgmstream_ydsp,
+    init_vgmstream_msvp,
+    init_vgmstream_ngc_ssm,
+    init_vgmstream_ps2_joe,
+    init_vgmstream_vgs,
+    init_vgmstream_dc_dcsw_dcs,
+    init_vgmstream_wii_smp,
+    init_vgmstream_emff_ps2,
+    init_vgmstream_emff_ngc,
+    init_vgmstream_ss_stream,
+    init_vgmstream_thp,
+    init_vgmstream_wii_sts,
+    init_vgmstream_ps2_p2bt,
+    init_vgmstream_ps2_gbts,
+    init_vgmstream_wii_sng,
+    init_vgmstream_ngc_dsp_iadp,
+    init_vgmstream_aax,
+    init_vgmstream_utf_dsp,
+    init_vgmstream_ngc_ffcc_str,
+    init_vgmstream_sat_baka,
+    init_vgmstream_nds_swav,
+    init_vgmstream_ps2_vsf,
+    init_vgmstream_nds_rrds,
+    init_vgmstream_ps2_tk5,
+    init_vgmstream_ps2_vsf_tta,
+    init_vgmstream_ads,
+    init_vgmstream_wii_str,
+    init_vgmstream_ps2_mcg,
+    init_vgmstream_zsd,
+    init_vgmstream_ps2_vgs,
+    init_vgmstream_RedSpark,
+    init_vgmstream_ivaud,
+    init_vgmstream_wii_wsd,
+    init_vgmstream_wii_ndp,
+    init_vgmstream_ps2_sps,
+    init_vgmstream_ps2_xa2_rrp,
+    init_vgmstream_nds_hwas,
+    init_vgmstream_ngc_lps,
+    init_vgmstream_ps2_snd,
+    init_vgmstream_naomi_adpcm,
+    init_vgmstream_sd9,
+    init_vgmstream_2dx9,
+    init_vgmstream_dsp_ygo,
+    init_vgmstream_ps2_vgv,
+    init_vgmstream_ngc_gcub,
+    init_vgmstream_maxis_xa,
+    init_vgmstream_ngc_sck_dsp,
+    init_vgmstream_apple_caff,
+    init_vgmstream_pc_mxst,
+    init_vgmstream_sab,
+    init_vgmstream_exakt_sc,
+    init_vgmstream_wii_bns,
+    init_vgmstream_wii_was,
+    init_vgmstream_pona_3do,
+    init_vgmstream_pona_psx,
+    init_vgmstream_xbox_hlwav,
+    init_vgmstream_stx,
+    init_vgmstream_ps2_stm,
+    init_vgmstream_myspd,
+    init_vgmstream_his,
+    init_vgmstream_ps2_ast,
+    init_vgmstream_dmsg,
+    init_vgmstream_ngc_dsp_aaap,
+    init_vgmstream_ngc_dsp_konami,
+    init_vgmstream_ps2_ster,
+    init_vgmstream_ps2_wb,
+    init_vgmstream_bnsf,
+    init_vgmstream_ps2_gcm,
+    init_vgmstream_ps2_smpl,
+    init_vgmstream_ps2_msa,
+    init_vgmstream_ps2_voi,
+    init_vgmstream_ps2_khv,
+    init_vgmstream_pc_smp,
+    init_vgmstream_ngc_bo2,
+    init_vgmstream_dsp_ddsp,
+    init_vgmstream_p3d,
+    init_vgmstream_ps2_tk1,
+    init_vgmstream_ps2_adsc,
+    init_vgmstream_ngc_dsp_mpds,
+    init_vgmstream_dsp_str_ig,
+    init_vgmstream_psx_mgav,
+    init_vgmstream_ngc_dsp_sth_str1,
+    init_vgmstream_ngc_dsp_sth_str2,
+    init_vgmstream_ngc_dsp_sth_str3,
+    init_vgmstream_ps2_b1s,
+    init_vgmstream_ps2_wad,
+    init_vgmstream_dsp_xiii,
+    init_vgmstream_dsp_cabelas,
+    init_vgmstream_ps2_adm,
+    init_vgmstream_ps2_lpcm,
+    init_vgmstream_dsp_bdsp,
+    init_vgmstream_ps2_vms,
+    init_vgmstream_ps2_xau,
+    init_vgmstream_gh3_bar,
+    init_vgmstream_ffw,
+    init_vgmstream_dsp_dspw,
+    init_vgmstream_ps2_jstm,
+    init_vgmstream_ps3_xvag,
+    init_vgmstream_ps3_cps,
+    init_vgmstream_sqex_scd,
+    init_vgmstream_ngc_nst_dsp,
+    init_vgmstream_baf,
+    init_vgmstream_ps3_msf,
+    init_vgmstream_fsb_mpeg,
+    init_vgmstream_nub_vag,
+    init_vgmstream_ps3_past,
+    init_vgmstream_ps3_sgh_sgb,
+    init_vgmstream_ngca,
+    init_vgmstream_wii_ras,
+    init_vgmstream_ps2_spm,
+    init_vgmstream_x360_tra,
+    init_vgmstream_ps2_iab,
+    init_vgmstream_ps2_strlr,
+    init_vgmstream_lsf_n1nj4n,
+    init_vgmstream_ps3_vawx,
+    init_vgmstream_pc_snds,
+    init_vgmstream_ps2_wmus,
+    init_vgmstream_hyperscan_kvag,
+    init_vgmstream_ios_psnd,
+    init_vgmstream_bos_adp,
+    init_vgmstream_eb_sfx,
+    init_vgmstream_eb_sf0,
+    init_vgmstream_ps3_klbs,
+    init_vgmstream_ps3_sgx,
+    init_vgmstream_ps2_mtaf,
+    init_vgmstream_tun,
+    init_vgmstream_wpd,
+    init_vgmstream_ps3_sgd,
+    init_vgmstream_mn_str,
+    init_vgmstream_ps2_mss,
+    init_vgmstream_ps2_hsf,
+    init_vgmstream_ps3_ivag,
+    init_vgmstream_ps2_2pfs,
+    init_vgmstream_xnbm,
+    init_vgmstream_rsd6oogv,
+    init_vgmstream_ubi_ckd,
+    init_vgmstream_ps2_vbk,
+    init_vgmstream_otm,
+    init_vgmstream_bcstm,
+    init_vgmstream_3ds_idsp,
+    init_vgmstream_g1l,
+    init_vgmstream_hca,
+};
+
+static const int probe_count = sizeof(probe_table) / sizeof(probe_table[0]);
+
+/// Maximum number of magic bytes an index entry can check.
+#define DETECT_MAGIC_SIZE 16
+#define DETECT_MAX_PROBES 4
+
+/** Index entry, a file whose extension matches and which starts with magic
+  * (if magic_size isn't 0) can only be opened by probes.
+  * Probes must list every meta that accepts the extension (see the extension
+  * checks in the metas) otherwise a later meta could win over an earlier one.
+  */
+struct detect_entry
+{
+    const char* extension;
+    const char* magic;
+    int magic_size;
+    probe_fn probes[DETECT_MAX_PROBES];
+};
+
+static const detect_entry detect_index[] =
+{
+    // Nintendo
+    {"bcstm", "CSTM", 4, {init_vgmstream_bcstm}},
+    {"bfstm", "FSTM", 4, {init_vgmstream_bfstm}},
+    {"bfwav", "FWAV", 4, {init_vgmstream_bfwav}},
+    {"bcwav", "CWAV", 4, {init_vgmstream_rwsd}},
+    {"brstm", "RSTM", 4, {init_vgmstream_brstm}},
+    {"btsnd", NULL, 0, {init_vgmstream_btsnd}},
+    {"ast", "STRM", 4, {init_vgmstream_ast}},
+    {"thp", "THP\0", 4, {init_vgmstream_thp}},
+    // CRI
+    {"hca", NULL, 0, {init_vgmstream_hca}},
+    {"aix", "AIXF", 4, {init_vgmstream_aix}},
+    {"aax", "@UTF", 4, {init_vgmstream_aax, init_vgmstream_utf_dsp}},
+    {"ahx", "\x80\x00", 2, {init_vgmstream_ahx}},
+    // Others
+    {"ogg", "OggS", 4, {init_vgmstream_ogg_vorbis, init_vgmstream_sfl}},
+    {"logg", "OggS", 4, {init_vgmstream_ogg_vorbis}},
+    {"wav", "RIFF", 4, {init_vgmstream_riff}},
+    {"lwav", "RIFF", 4, {init_vgmstream_riff}},
+    {"nwa", NULL, 0, {init_vgmstream_nwa}},
+    {"acm", NULL, 0, {init_vgmstream_acm}},
+    {"scd", "SEDBSSCF", 8, {init_vgmstream_sqex_scd}},
+    {"mca", "MADP", 4, {init_vgmstream_mca}},
+    {"g1l", NULL, 0, {init_vgmstream_g1l}},
+    {"msf", NULL, 0, {init_vgmstream_ps3_msf}},
+};
+
+static int find_probe(probe_fn probe)
+{
+    for (int i = 0; i < probe_count; i++)
+    {
+        if (probe_table[i] == probe)
+            return i;
+    }
+    return -1;
+}
+
+/// Metas init_vgmstream_internal looks for a second mono file with.
+static bool is_dual_file_meta(meta_t meta)
+{
+    switch (meta)
+    {
+        case meta_DSP_STD:
+        case meta_PS2_VAGp:
+        case meta_GENH:
+        case meta_KRAW:
+        case meta_PS2_MIB:
+        case meta_NGC_LPS:
+        case meta_DSP_YGO:
+        case meta_DSP_AGSC:
+        case meta_PS2_SMPL:
+        case meta_NGCA:
+        case meta_NUB_VAG:
+        case meta_SPT_SPD:
+        case meta_EB_SFX:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// What init_vgmstream_internal does to a VGMSTREAM after a probe accepted the file.
+static VGMSTREAM* finish_vgmstream(VGMSTREAM* vgmstream, STREAMFILE* streamfile)
+{
+    if (!check_sample_rate(vgmstream->sample_rate))
+    {
+        close_vgmstream(vgmstream);
+        return NULL;
+    }
+
+    if (is_dual_file_meta(vgmstream->meta_type) && vgmstream->channels == 1)
+        try_dual_file_stereo(vgmstream, streamfile);
+
+    // save start things so we can restart
+    memcpy(vgmstream->start_ch, vgmstream->ch, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+    memcpy(vgmstream->start_vgmstream, vgmstream, sizeof(VGMSTREAM));
+    return vgmstream;
+}
+
+static VGMSTREAM* run_probe(int index, STREAMFILE* streamfile, detect_stats* stats)
+{
+    stats->probes++;
+    VGMSTREAM* vgmstream = probe_table[index](streamfile);
+    if (vgmstream)
+        vgmstream = finish_vgmstream(vgmstream, streamfile);
+    if (vgmstream)
+        stats->winner = index;
+    return vgmstream;
+}
+
+/// run_probe for the probe a previous detection picked, reusing what it found instead of searching the file again.
+static VGMSTREAM* run_hinted_probe(const vgmstream_info* hint, STREAMFILE* streamfile, detect_stats* stats)
+{
+    const coding_t coding_type = static_cast<coding_t>(hint->coding_type);
+    if (probe_table[hint->probe] == init_vgmstream_adx && (coding_type == coding_CRI_ADX_enc_8 || coding_type == coding_CRI_ADX_enc_9))
+    {
+        stats->probes++;
+        VGMSTREAM* vgmstream = init_vgmstream_adx_keyed(streamfile, coding_type, hint->adx_key);
+        if (vgmstream)
+            vgmstream = finish_vgmstream(vgmstream, streamfile);
+        if (vgmstream)
+        {
+            stats->winner = hint->probe;
+            return vgmstream;
+        }
+    }
+    return run_probe(hint->probe, streamfile, stats);
+}
+
+static_assert(DETECT_MAX_PROBES * (sizeof(detect_index) / sizeof(detect_index[0])) <= DETECT_MAX_CANDIDATES,
+              "DETECT_MAX_CANDIDATES too small for the index");
+
+int detect_candidates(STREAMFILE* streamfile, int* candidates)
+{
+    char filename[PATH_LIMIT];
+    streamfile->get_name(streamfile, filename, sizeof(filename));
+    const char* extension = filename_extension(filename);
+
+    uint8_t magic[DETECT_MAGIC_SIZE];
+    size_t magic_read = read_streamfile(magic, 0, sizeof(magic), streamfile);
+
+    int count = 0;
+    for (const auto& entry : detect_index)
+    {
+        if (strcasecmp(entry.extension, extension))
+            continue;
+        if (entry.magic_size && (magic_read < static_cast<size_t>(entry.magic_size) || memcmp(magic, entry.magic, entry.magic_size)))
+            continue;
+
+        for (int i = 0; i < DETECT_MAX_PROBES && entry.probes[i]; i++)
+        {
+            int index = find_probe(entry.probes[i]);
+            if (index >= 0 && std::find(candidates, candidates + count, index) == candidates + count)
+                candidates[count++] = index;
+        }
+    }
+
+    // keep vgmstream's order so the same meta wins as in a full scan
+    std::sort(candidates, candidates + count);
+    return count;
+}
+
+int detect_probe_count(void)
+{
+    return probe_count;
+}
+
+int detect_find_probe(VGMSTREAM* (*probe)(STREAMFILE*))
+{
+    return find_probe(probe);
+}
+
+VGMSTREAM* detect_vgmstream(STREAMFILE* streamfile, detect_stats* stats, const vgmstream_info* hint)
+{
+    detect_stats local_stats;
+    if (!stats)
+        stats = &local_stats;
+    stats->probes = 0;
+    stats->winner = -1;
+    stats->source = DETECT_FULL_SCAN;
+
+    if (!streamfile)
+        return NULL;
+
+    if (hint && hint->probe >= 0 && hint->probe < probe_count)
+    {
+        VGMSTREAM* vgmstream = run_hinted_probe(hint, streamfile, stats);
+        if (vgmstream)
+        {
+            stats->source = DETECT_HINTED;
+            return vgmstream;
+        }
+    }
+
+    int candidates[DETECT_MAX_CANDIDATES];
+    int count = detect_candidates(streamfile, candidates);
+    for (int i = 0; i < count; i++)
+    {
+        VGMSTREAM* vgmstream = run_probe(candidates[i], streamfile, stats);
+        if (vgmstream)
+        {
+            stats->source = DETECT_INDEXED;
+            return vgmstream;
+        }
+    }
+
+    for (int i = 0; i < probe_count; i++)
+    {
+        // already turned the file down
+        if (std::find(candidates, candidates + count, i) != candidates + count)
+            continue;
+        VGMSTREAM* vgmstream = run_probe(i, streamfile, stats);
+        if (vgmstream)
+            return vgmstream;
+    }
+
+    return NULL;
+}
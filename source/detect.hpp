@@ -0,0 +1,54 @@
+#ifndef DETECT_HPP
+#define DETECT_HPP
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+#include "probe_cache.hpp"
+
+/// Where the probe that opened a file came from.
+enum detect_source
+{
+    DETECT_FULL_SCAN,
+    DETECT_INDEXED,
+    /// The caller already knew which probe opens the file (probe cache).
+    DETECT_HINTED,
+};
+
+/// What format detection had to do to open a file.
+struct detect_stats
+{
+    /// Number of init_vgmstream_* probes run, including the winning one.
+    int probes;
+    /// Index of the probe that opened the file in the probe table, -1 if none did.
+    int winner;
+    detect_source source;
+};
+
+/** Same detection as init_vgmstream_from_STREAMFILE except that probes known to
+  * handle the file's extension and magic are tried first, only if none of them
+  * accept the file are all probes tried in vgmstream's order.
+  * If hint is what a previous detection found out about the file (the probe cache),
+  * its probe is tried before anything else, skipping searches whose results it holds.
+  * Returns NULL if no probe accepted the file.
+  */
+VGMSTREAM* detect_vgmstream(STREAMFILE* streamfile, detect_stats* stats = NULL, const vgmstream_info* hint = NULL);
+
+/// Number of probes in the table, changes whenever the probe indexes do.
+int detect_probe_count(void);
+
+/// Index of probe in the probe table, -1 if libvgmstream doesn't run it.
+int detect_find_probe(VGMSTREAM* (*probe)(STREAMFILE*));
+
+/// Upper bound on what detect_candidates returns.
+#define DETECT_MAX_CANDIDATES 128
+
+/** Fills candidates with the indexes of the probes that may open the file based
+  * on its extension and magic, sorted in the order a full scan tries them.
+  * Returns how many, 0 if the file isn't indexed.
+  */
+int detect_candidates(STREAMFILE* streamfile, int* candidates);
+
+#endif
@@ -0,0 +1,348 @@
+#include "library.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+extern "C"
+{
+    #include <dirent.h>
+    #include <3ds.h>
+}
+
+#include "detect.hpp"
+#include "probe_info.hpp"
+#include "spsc_queue.hpp"
+#include "streamfile_ext.hpp"
+
+#define LIBRARY_INDEX_VERSION 2
+/// Probed entries per batch, the ui merges a batch at a time.
+#define LIBRARY_BATCH_SIZE 32
+#define LIBRARY_QUEUE_SIZE 16
+#define LIBRARY_STACK_SIZE (64 * 1024)
+
+enum library_batch_type
+{
+    /// Entries loaded from the index file.
+    BATCH_INDEX,
+    /// Entries that were new or changed.
+    BATCH_SCAN,
+    /// Every entry the walk found, sorted.
+    BATCH_DONE,
+};
+
+struct library_batch
+{
+    library_batch_type type;
+    std::vector<library_entry> entries;
+};
+
+struct library_index_header
+{
+    char magic[4];
+    uint32_t version;
+    /// detect_probe_count() of the build that wrote it, see probe_cache_header.
+    uint32_t probe_count;
+    uint32_t count;
+};
+
+static spsc_queue<library_batch*, LIBRARY_QUEUE_SIZE> queue;
+static std::atomic<bool> stop_indexer(false);
+static Thread indexer_thread = NULL;
+static std::string library_directory;
+static std::string library_index_file;
+/// Only touched by the thread calling library_poll.
+static bool scan_done = false;
+
+static bool compare_path(const library_entry& entry, const std::string& path)
+{
+    return entry.path < path;
+}
+
+static bool compare_entries(const library_entry& a, const library_entry& b)
+{
+    return a.path < b.path;
+}
+
+static void make_index_header(library_index_header* header, uint32_t count)
+{
+    memcpy(header->magic, "VGLI", 4);
+    header->version = LIBRARY_INDEX_VERSION;
+    header->probe_count = detect_probe_count();
+    header->count = count;
+}
+
+/// Returns the entries of the index file, empty if it's missing or was written by another build.
+static std::vector<library_entry> load_index(void)
+{
+    std::vector<library_entry> entries;
+    std::vector<uint8_t> data;
+    FILE* file = fopen(library_index_file.c_str(), "rb");
+    if (!file)
+        return entries;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0)
+    {
+        data.resize(size);
+        if (fread(data.data(), 1, size, file) != static_cast<size_t>(size))
+            data.clear();
+    }
+    fclose(file);
+
+    library_index_header header, expected;
+    if (data.size() < sizeof(header))
+        return entries;
+    memcpy(&header, data.data(), sizeof(header));
+    make_index_header(&expected, header.count);
+    if (memcmp(&header, &expected, sizeof(header)))
+        return entries;
+
+    // u16 path length, path, u32 size, u64 mtime, u8 playable, vgmstream_info
+    size_t pos = sizeof(header);
+    entries.reserve(header.count);
+    for (uint32_t i = 0; i < header.count; i++)
+    {
+        uint16_t length;
+        if (data.size() - pos < sizeof(length))
+            break;
+        memcpy(&length, &data[pos], sizeof(length));
+        pos += sizeof(length);
+        if (data.size() - pos < length + sizeof(uint32_t) + sizeof(uint64_t) + 1 + sizeof(vgmstream_info))
+            break;
+
+        library_entry entry;
+        entry.path.assign(reinterpret_cast<const char*>(&data[pos]), length);
+        pos += length;
+        memcpy(&entry.size, &data[pos], sizeof(entry.size));
+        pos += sizeof(entry.size);
+        memcpy(&entry.mtime, &data[pos], sizeof(entry.mtime));
+        pos += sizeof(entry.mtime);
+        entry.playable = data[pos++];
+        memcpy(&entry.info, &data[pos], sizeof(entry.info));
+        pos += sizeof(entry.info);
+        entries.push_back(entry);
+    }
+
+    // it's written sorted but don't trust the sd card
+    std::sort(entries.begin(), entries.end(), compare_entries);
+    return entries;
+}
+
+/// entries must be sorted. The directory was created by probe_cache_load.
+static void save_index(const std::vector<library_entry>& entries)
+{
+    FILE* file = fopen(library_index_file.c_str(), "wb");
+    if (!file)
+        return;
+
+    library_index_header header;
+    make_index_header(&header, entries.size());
+    fwrite(&header, sizeof(header), 1, file);
+    for (const auto& entry : entries)
+    {
+        uint16_t length = entry.path.size();
+        uint8_t playable = entry.playable;
+        fwrite(&length, sizeof(length), 1, file);
+        fwrite(entry.path.data(), 1, length, file);
+        fwrite(&entry.size, sizeof(entry.size), 1, file);
+        fwrite(&entry.mtime, sizeof(entry.mtime), 1, file);
+        fwrite(&playable, sizeof(playable), 1, file);
+        fwrite(&entry.info, sizeof(entry.info), 1, file);
+    }
+    fclose(file);
+}
+
+/// Hands batch over to the ui, waits while the queue is full. Returns false if stopped meanwhile.
+static bool publish(library_batch* batch)
+{
+    while (!queue.push(batch))
+    {
+        if (stop_indexer)
+        {
+            delete batch;
+            return false;
+        }
+        svcSleepThread(10 * 1000 * 1000);
+    }
+    return true;
+}
+
+static void probe_entry(const std::string& filename, library_entry* entry)
+{
+    // only headers get read, the default buffer is plenty
+    STREAMFILE* streamfile = open_ext_streamfile(filename.c_str(), STREAMFILE_MODE_BUFFERED);
+    entry->playable = probe_vgmstream_info(streamfile, &entry->info);
+    if (!entry->playable)
+        memset(&entry->info, 0, sizeof(entry->info));
+    if (streamfile)
+        close_streamfile(streamfile);
+}
+
+static bool is_directory(const std::string& filename, const struct dirent* dir)
+{
+    if (dir->d_type != DT_UNKNOWN)
+        return dir->d_type == DT_DIR;
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void indexer_main(void* arg)
+{
+    std::vector<library_entry> known = load_index();
+    if (!known.empty() && !publish(new library_batch{BATCH_INDEX, known}))
+        return;
+
+    std::vector<library_entry> found;
+    library_batch* batch = new library_batch{BATCH_SCAN, {}};
+    // depth first, directories are relative to library_directory
+    std::vector<std::string> pending(1);
+    while (!pending.empty() && !stop_indexer)
+    {
+        std::string directory = pending.back();
+        pending.pop_back();
+
+        DIR* d = opendir((library_directory + "/" + directory).c_str());
+        if (!d)
+            continue;
+
+        struct dirent* dir;
+        while ((dir = readdir(d)) != NULL && !stop_indexer)
+        {
+            if (!strcmp(dir->d_name, ".") || !strcmp(dir->d_name, ".."))
+                continue;
+
+            library_entry entry;
+            entry.path = directory.empty() ? dir->d_name : directory + "/" + dir->d_name;
+            std::string filename = library_directory + "/" + entry.path;
+            if (is_directory(filename, dir))
+            {
+                pending.push_back(entry.path);
+                continue;
+            }
+            if (!get_file_stamp(filename.c_str(), &entry.size, &entry.mtime))
+                continue;
+
+            auto it = std::lower_bound(known.begin(), known.end(), entry.path, compare_path);
+            if (it != known.end() && it->path == entry.path && it->size == entry.size && it->mtime == entry.mtime)
+            {
+                // already published with the index
+                found.push_back(*it);
+                continue;
+            }
+
+            probe_entry(filename, &entry);
+            found.push_back(entry);
+            batch->entries.push_back(entry);
+            if (batch->entries.size() >= LIBRARY_BATCH_SIZE)
+            {
+                if (!publish(batch))
+                {
+                    closedir(d);
+                    return;
+                }
+                batch = new library_batch{BATCH_SCAN, {}};
+            }
+        }
+        closedir(d);
+    }
+
+    if (stop_indexer)
+    {
+        delete batch;
+        return;
+    }
+    if (!batch->entries.empty())
+    {
+        if (!publish(batch))
+            return;
+    }
+    else
+    {
+        delete batch;
+    }
+
+    std::sort(found.begin(), found.end(), compare_entries);
+    save_index(found);
+    publish(new library_batch{BATCH_DONE, std::move(found)});
+}
+
+/// Merges batch into entries, both sorted, entries from batch replace those with the same path.
+static void merge_entries(std::vector<library_entry>& entries, std::vector<library_entry>& batch)
+{
+    std::sort(batch.begin(), batch.end(), compare_entries);
+
+    std::vector<library_entry> merged;
+    merged.reserve(entries.size() + batch.size());
+    auto it = entries.begin();
+    for (auto& entry : batch)
+    {
+        while (it != entries.end() && it->path < entry.path)
+            merged.push_back(std::move(*it++));
+        if (it != entries.end() && it->path == entry.path)
+            ++it;
+        merged.push_back(std::move(entry));
+    }
+    while (it != entries.end())
+        merged.push_back(std::move(*it++));
+    entries.swap(merged);
+}
+
+void library_start(const std::string& directory, const std::string& index_file)
+{
+    library_directory = directory;
+    library_index_file = index_file;
+    stop_indexer = false;
+    scan_done = false;
+
+    // below the ui and decoding so it only gets their idle time
+    s32 prio = 0;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    indexer_thread = threadCreate(indexer_main, NULL, LIBRARY_STACK_SIZE, prio + 1, -2, false);
+    if (!indexer_thread)
+        scan_done = true;
+}
+
+bool library_poll(std::vector<library_entry>& entries)
+{
+    bool changed = false;
+    library_batch* batch;
+    while (queue.pop(batch))
+    {
+        if (batch->type == BATCH_DONE)
+        {
+            entries.swap(batch->entries);
+            scan_done = true;
+        }
+        else
+        {
+            merge_entries(entries, batch->entries);
+        }
+        delete batch;
+        changed = true;
+    }
+    return changed;
+}
+
+bool library_scanning(void)
+{
+    return !scan_done;
+}
+
+void library_stop(void)
+{
+    if (!indexer_thread)
+        return;
+
+    stop_indexer = true;
+    threadJoin(indexer_thread, U64_MAX);
+    threadFree(indexer_thread);
+    indexer_thread = NULL;
+
+    library_batch* batch;
+    while (queue.pop(batch))
+        delete batch;
+}
@@ -0,0 +1,42 @@
+#ifndef LIBRARY_HPP
+#define LIBRARY_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "probe_cache.hpp"
+
+/// A file found under the music directory.
+struct library_entry
+{
+    /// Path relative to the music directory.
+    std::string path;
+    uint32_t size;
+    uint64_t mtime;
+    /// False if vgmstream can't open the file, info is zeroed then.
+    bool playable;
+    vgmstream_info info;
+};
+
+/** Starts the indexer thread which walks directory recursively and probes every
+  * file it finds. The entries saved in index_file by the previous run come
+  * through library_poll first, files whose size and modification time didn't
+  * change since are not probed again. The index is rewritten once the walk is over.
+  */
+void library_start(const std::string& directory, const std::string& index_file);
+
+/** Takes in whatever the indexer published since the last call, entries is kept
+  * sorted by path. Once the walk is over entries is replaced by its full result
+  * so deleted files go away. Returns true if entries changed.
+  * Must always be called from the same thread.
+  */
+bool library_poll(std::vector<library_entry>& entries);
+
+/// True until library_poll has taken in the result of the full walk.
+bool library_scanning(void);
+
+/// Stops the indexer thread, an unfinished walk isn't saved.
+void library_stop(void);
+
+#endif
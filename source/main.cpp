@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
@@ -7,7 +8,6 @@
 
 extern "C"
 {
-    #include <dirent.h>
     #include <3ds.h>
     #include <util.h>
     #include <vgmstream.h>
@@ -17,11 +17,20 @@ extern "C"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include "buffer_plan.hpp"
 #include "config.hpp"
+#include "detect.hpp"
+#include "library.hpp"
+#include "playback_arena.hpp"
+#include "probe_cache.hpp"
+#include "render.hpp"
+#include "streamfile_ext.hpp"
 #include "version.hpp"
 
 #define CONSOLE_WIDTH 50
 #define CONSOLE_HEIGHT (28 - 1)
+/// The player decoders fetch runs of frames into stack buffers of up to a few KB.
+#define DECODE_STACK_SIZE (16 * 1024)
 
 struct stream_buffer
 {
@@ -32,13 +41,16 @@ struct stream_buffer
 struct stream_filename
 {
     VGMSTREAM* stream;
+    stream_renderer renderer;
     std::string filename;
 };
 
-std::vector<std::string> files;
+std::vector<library_entry> files;
 unsigned int current_index = 0;
 
 volatile bool runThreads = true;
+/// Seconds to seek by, added to by the ui and taken by the decode thread before its next buffer.
+std::atomic<int> seek_request(0);
 /// Handle signaling more data is ready to be played
 Handle bufferReadyConsumeRequest;
 /// Handle signaling more data is ready to be decoded
@@ -51,8 +63,13 @@ LightLock debug_lock;
 // and the other will be used for unraveling channel data from vgmstream
 stream_buffer playBuffer1;
 stream_buffer playBuffer2;
-// Raw samples from vgmstream
+// Interleaved samples from vgmstream for streams render_planar can't write out directly
 sample* rawSampleBuffer = NULL;
+/// Samples per channel of playBuffer1 and playBuffer2, planned for every song.
+u32 buffer_samples = 0;
+/// Linear memory reserved once for the buffers above, reset after every song.
+void* arena_memory = NULL;
+playback_arena arena;
 
 PrintConsole topScreen, bottomScreen;
 
@@ -120,20 +137,18 @@ void AptEventHook(APT_HookType hookType, void* param)
 }
 */
 
-void getFiles(void)
+/// Takes in what the library indexer found so far, keeping the same file selected.
+bool updateFiles(void)
 {
-    struct dirent* dir;
-    DIR* d = opendir(music_directory.c_str());
-    if (d)
-    {
-        while ((dir = readdir(d)) != NULL)
-        {
-            files.push_back(dir->d_name);
-        }
-        closedir(d);
-    }
-
-    std::sort(files.begin(), files.end());
+    std::string selected = files.empty() ? "" : files[current_index].path;
+    if (!library_poll(files))
+        return false;
+
+    current_index = std::lower_bound(files.begin(), files.end(), selected,
+        [](const library_entry& file, const std::string& path) { return file.path < path; }) - files.begin();
+    if (current_index >= files.size())
+        current_index = files.empty() ? 0 : files.size() - 1;
+    return true;
 }
 
 void playSoundChannels(int startchn, int samples, bool loop, std::vector<sample*>& data, std::vector<ndspWaveBuf>& waveBufs)
@@ -251,7 +266,6 @@ void decodeThread(void* arg)
     if (!vgmstream)
         return;
 
-    const int channels = vgmstream->channels;
     const u32 stream_samples_amount = get_vgmstream_play_samples(1, 0, 0, vgmstream);
     u32 current_sample_pos = 0;
     stream_buffer* buffer = &playBuffer1;
@@ -263,7 +277,15 @@ void decodeThread(void* arg)
         svcWaitSynchronization(bufferReadyProduceRequest, U64_MAX);
         svcClearEvent(bufferReadyProduceRequest);
 
-        u32 toget = max_samples;
+        int seek = seek_request.exchange(0);
+        if (seek)
+        {
+            // scd_int substreams count the samples, the parent's current_sample stays at 0
+            seek_planar(vgmstream, &strm_file->renderer, get_position_stream(vgmstream)->current_sample + seek * vgmstream->sample_rate);
+            current_sample_pos = get_position_stream(vgmstream)->current_sample;
+        }
+
+        u32 toget = buffer_samples;
 
         if (!vgmstream->loop_flag)
         {
@@ -274,26 +296,16 @@ void decodeThread(void* arg)
         }
 
         debug("decode_buffer decode %d\n", toget);
-        // TODO modify render_vgmstream to return not decode channel data sequentially in the buffer passed in.
-        render_vgmstream(rawSampleBuffer, toget, vgmstream);
-
-        debug("decode_buffer detangle\n");
-        // Detangle audio data...
+        // channels come out separated, rawSampleBuffer is only used by layouts the player doesn't render itself
+        render_planar(vgmstream, &strm_file->renderer, buffer->channels.data(), toget, rawSampleBuffer);
         buffer->samples = toget;
-        for (u32 i = 0; i < max_samples; i++)
-        {
-            for (int j = 0; j < channels; j++)
-            {
-                buffer->channels[j][i] = rawSampleBuffer[i * channels + j];
-            }
-        }
 
         debug("decode_buffer signal consume\n");
         // Ready to play
         svcSignalEvent(bufferReadyConsumeRequest);
 
         clearTopScreen();
-        print("\x1b[1;0HCurrently playing %s\nPress B to choose another song\nPress Start to exit", filename.c_str());
+        print("\x1b[1;0HCurrently playing %s\nPress B to choose another song\nPress Left/Right to seek\nPress Start to exit", filename.c_str());
         print("\x1b[29;0HPLAYING %.4lf %.4lf\n", (float)current_sample_pos / vgmstream->sample_rate, (float)stream_samples_amount / vgmstream->sample_rate);
         current_sample_pos += toget;
 
@@ -327,30 +339,42 @@ void refresh(void)
             (files.size() < CONSOLE_HEIGHT ? 0 : files.size() - CONSOLE_HEIGHT) :
             current_index;
     end = std::min(start + CONSOLE_HEIGHT, files.size() - 1);
-    print("3ds-vgmstream v%s\n", version_str);
+    print("3ds-vgmstream v%s%s\n", version_str, library_scanning() ? " (scanning)" : "");
+    if (files.empty())
+        return;
     for (unsigned int i = start; i <= end; i++)
     {
+        const library_entry& file = files[i];
+        char length[8] = "";
+        if (file.playable && file.info.sample_rate > 0)
+        {
+            int seconds = file.info.num_samples / file.info.sample_rate;
+            snprintf(length, sizeof(length), "%d:%02d", seconds / 60, seconds % 60);
+        }
         print(i == current_index ? ">" : " ");
-        print("%s\n", files[i].c_str());
+        print("%-*.*s%7s\n", CONSOLE_WIDTH - 8, CONSOLE_WIDTH - 8, file.path.c_str(), length);
     }
 }
 
 std::string select_file(void)
 {
-    if (files.empty())
-    {
-        print("Place music files in the following directory\n%s\non root of sd card\n\n", music_directory.c_str());
-        return "";
-    }
-
+    updateFiles();
     refresh();
 
     bool quitting = false;
     while (aptMainLoop())
     {
+        if (updateFiles())
+            refresh();
+        if (files.empty() && !library_scanning())
+        {
+            print("Place music files in the following directory\n%s\non root of sd card\n\n", music_directory.c_str());
+            return "";
+        }
+
         hidScanInput();
         u32 kDown = getKeyState();
-        if (kDown & KEY_START || kDown & KEY_A)
+        if (kDown & KEY_START || (kDown & KEY_A && !files.empty()))
         {
             quitting = kDown & KEY_START;
             break;
@@ -375,10 +399,16 @@ std::string select_file(void)
     if (quitting)
         return "";
 
-    std::string ret = music_directory + "/" + files[current_index];
+    std::string ret = music_directory + "/" + files[current_index].path;
     return ret;
 }
 
+/// Small files are kept in memory so decoding never goes back to the sd card.
+STREAMFILE* open_streamfile(const std::string& filename)
+{
+    return open_ext_streamfile_limited(filename.c_str(), memory_streamfile_limit);
+}
+
 bool stream_file(const std::string& filename)
 {
     if (filename.empty())
@@ -387,43 +417,80 @@ bool stream_file(const std::string& filename)
         return true;
     }
 
-    VGMSTREAM* vgmstream = init_vgmstream(filename.c_str());
+    detect_stats stats;
+    vgmstream_info info;
+    u64 open_start = svcGetSystemTick();
+    bool cached = probe_cache_find(filename.c_str(), &info);
+    STREAMFILE* streamfile = open_streamfile(filename);
+    VGMSTREAM* vgmstream = detect_vgmstream(streamfile, &stats, cached ? &info : NULL);
+    // vgmstream opens its own streamfiles for the channels
+    if (streamfile)
+        close_streamfile(streamfile);
+    static const char* sources[] = {"full scan", "indexed", "cached"};
+    debug("open %.2lfms probes %d (%s)\n", (svcGetSystemTick() - open_start) * 1000.0 / SYSCLOCK_ARM11, stats.probes, sources[stats.source]);
     if (!vgmstream)
     {
         print("Bad file %s\n", filename.c_str());
         return true;
     }
-
-    const int channels = vgmstream->channels;
-    u32 buffer_size = max_samples * vgmstream->channels * sizeof(sample);
-
-    rawSampleBuffer = static_cast<sample*>(linearAlloc(buffer_size));
-    sample* buffer = static_cast<sample*>(linearAlloc(buffer_size));
-    sample* buffer2 = static_cast<sample*>(linearAlloc(buffer_size));
-    playBuffer1.samples = max_samples;
-    playBuffer2.samples = max_samples;
-    for (int i = 0; i < channels; i++)
+    if (stats.source != DETECT_HINTED)
     {
-        playBuffer1.channels.push_back(buffer + i * max_samples);
-        playBuffer2.channels.push_back(buffer2 + i * max_samples);
+        get_vgmstream_info(vgmstream, stats.winner, &info);
+        probe_cache_store(filename.c_str(), &info);
     }
+    advise_vgmstream_streamfiles(vgmstream);
 
+    const int channels = vgmstream->channels;
     stream_filename strm_file;
     strm_file.filename = filename;
     strm_file.stream = vgmstream;
+    init_stream_renderer(vgmstream, &strm_file.renderer);
+
+    buffer_plan_request request;
+    request.channels = channels;
+    request.sample_rate = vgmstream->sample_rate;
+    // the player's own per channel decoders are the cheap ones
+    request.cost = strm_file.renderer.render && !strm_file.renderer.decoder.stream ? DECODE_COST_LIGHT : DECODE_COST_HEAVY;
+    request.scratch = !strm_file.renderer.render;
+    request.available = playback_arena_available(&arena);
+    request.max_samples = max_samples;
+    buffer_plan plan;
+    if (!plan_buffers(&request, &plan))
+    {
+        close_stream_renderer(&strm_file.renderer);
+        close_vgmstream(vgmstream);
+        print("Not enough memory for %d channels\n", channels);
+        return false;
+    }
+    debug("buffers %u samples%s\n", static_cast<unsigned>(plan.samples), plan.degraded ? " (short on memory)" : "");
+
+    buffer_samples = plan.samples;
+    rawSampleBuffer = plan.scratch_size ? static_cast<sample*>(playback_arena_alloc(&arena, plan.scratch_size)) : NULL;
+    sample* buffer = static_cast<sample*>(playback_arena_alloc(&arena, plan.buffer_size));
+    sample* buffer2 = static_cast<sample*>(playback_arena_alloc(&arena, plan.buffer_size));
+    playBuffer1.samples = buffer_samples;
+    playBuffer2.samples = buffer_samples;
+    for (int i = 0; i < channels; i++)
+    {
+        playBuffer1.channels.push_back(buffer + i * buffer_samples);
+        playBuffer2.channels.push_back(buffer2 + i * buffer_samples);
+    }
 
     runThreads = true;
+    seek_request = 0;
 
     s32 prio = 0;
     Thread musicThread;
     Thread produceThread;
     svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
     musicThread = threadCreate(streamMusic, &strm_file, 4 * 1024, prio-1, -2, false);
-    produceThread = threadCreate(decodeThread, &strm_file, 4 * 1024, prio-1, -2, false);
+    produceThread = threadCreate(decodeThread, &strm_file, DECODE_STACK_SIZE, prio-1, -2, false);
 
     bool ret = false;
     while (aptMainLoop())
     {
+        // keeps the indexer from stalling on a full queue
+        updateFiles();
         hidScanInput();
         u32 kDown = hidKeysDown();
         if (kDown & KEY_START || kDown & KEY_B)
@@ -431,6 +498,10 @@ bool stream_file(const std::string& filename)
             ret = kDown & KEY_START;
             break;
         }
+        if (kDown & KEY_LEFT)
+            seek_request -= seek_seconds;
+        if (kDown & KEY_RIGHT)
+            seek_request += seek_seconds;
         gfxFlushBuffers();
         gfxSwapBuffers();
 
@@ -448,12 +519,13 @@ bool stream_file(const std::string& filename)
     svcClearEvent(bufferReadyProduceRequest);
 
 
-    linearFree(rawSampleBuffer);
-    linearFree(buffer);
-    linearFree(buffer2);
+    debug("arena high water %u of %u bytes\n", static_cast<unsigned>(arena.high_water), static_cast<unsigned>(arena.size));
+    playback_arena_reset(&arena);
+    rawSampleBuffer = NULL;
     playBuffer1.channels.clear();
     playBuffer2.channels.clear();
 
+    close_stream_renderer(&strm_file.renderer);
     close_vgmstream(vgmstream);
 
     return ret;
@@ -477,7 +549,12 @@ int main(void)
 
     svcCreateEvent(&bufferReadyConsumeRequest, RESET_STICKY);
     svcCreateEvent(&bufferReadyProduceRequest, RESET_STICKY);
-    getFiles();
+    // whatever is left if the budget doesn't fit, songs that don't fit in it are refused
+    u32 arena_size = std::min<u32>(playback_arena_budget, linearSpaceFree() & ~(PLAYBACK_ARENA_ALIGNMENT - 1));
+    arena_memory = linearAlloc(arena_size);
+    playback_arena_init(&arena, arena_memory, arena_size);
+    probe_cache_load(probe_cache_file.c_str());
+    library_start(music_directory, library_index_file);
 
     bool exit = false;
     while (!exit)
@@ -486,6 +563,8 @@ int main(void)
         exit = stream_file(filename);
     }
 
+    library_stop();
+    linearFree(arena_memory);
     ndspExit();
     gfxExit();
 
@@ -0,0 +1,195 @@
+#include "nwa_prefetch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef _3DS
+extern "C"
+{
+    #include <3ds.h>
+}
+#endif
+
+/// Puts block into nwa's buffer, same as nwa_decode_block does since seek_nwa to the start of a block only decodes that block.
+static void decode_nwa_block(NWAData* nwa, int block)
+{
+    seek_nwa(nwa, block * (nwa->blocksize / nwa->channels));
+}
+
+// host builds have no worker, blocks are always decoded in place
+#ifdef _3DS
+/// Decoded blocks the worker keeps ready.
+#define NWA_PREFETCH_BLOCKS 4
+#define NWA_PREFETCH_STACK_SIZE (16 * 1024)
+
+struct nwa_prefetch_block
+{
+    std::vector<sample> samples;
+    int sample_count;
+};
+
+struct nwa_prefetch
+{
+    /// Only touched by the worker once it's started.
+    NWAData* nwa;
+    Thread thread;
+    LightLock lock;
+    /// Signaled when a slot frees up or the worker has to start over.
+    LightEvent work;
+    /// Signaled when a block is ready.
+    LightEvent ready;
+
+    /// Everything below is guarded by lock.
+    bool stop;
+    /// Next block the player wants and how many from there on are in blocks.
+    int first_block;
+    int decoded;
+    /// Bumped whenever first_block jumps, blocks decoded for an older one are thrown away.
+    unsigned int generation;
+    /// Block i lives in blocks[i % NWA_PREFETCH_BLOCKS].
+    nwa_prefetch_block blocks[NWA_PREFETCH_BLOCKS];
+};
+
+static void prefetch_main(void* arg)
+{
+    nwa_prefetch* prefetch = static_cast<nwa_prefetch*>(arg);
+    NWAData* nwa = prefetch->nwa;
+
+    LightLock_Lock(&prefetch->lock);
+    while (!prefetch->stop)
+    {
+        int block = prefetch->first_block + prefetch->decoded;
+        if (prefetch->decoded >= NWA_PREFETCH_BLOCKS || block >= nwa->blocks)
+        {
+            LightLock_Unlock(&prefetch->lock);
+            LightEvent_Wait(&prefetch->work);
+            LightLock_Lock(&prefetch->lock);
+            continue;
+        }
+
+        unsigned int generation = prefetch->generation;
+        LightLock_Unlock(&prefetch->lock);
+        decode_nwa_block(nwa, block);
+        LightLock_Lock(&prefetch->lock);
+
+        if (generation != prefetch->generation)
+            continue;
+        nwa_prefetch_block& slot = prefetch->blocks[block % NWA_PREFETCH_BLOCKS];
+        slot.sample_count = nwa->samples_in_buffer;
+        memcpy(slot.samples.data(), nwa->buffer, slot.sample_count * sizeof(sample));
+        prefetch->decoded++;
+        LightEvent_Signal(&prefetch->ready);
+    }
+    LightLock_Unlock(&prefetch->lock);
+}
+
+nwa_prefetch* nwa_prefetch_open(NWAData* nwa)
+{
+    if (nwa->blocks <= 1 || nwa->channels <= 0)
+        return NULL;
+
+    char filename[PATH_LIMIT];
+    nwa->file->get_name(nwa->file, filename, sizeof(filename));
+    NWAData* worker_nwa = open_nwa(nwa->file, filename);
+    if (!worker_nwa)
+        return NULL;
+
+    nwa_prefetch* prefetch = new nwa_prefetch();
+    prefetch->nwa = worker_nwa;
+    LightLock_Init(&prefetch->lock);
+    LightEvent_Init(&prefetch->work, RESET_ONESHOT);
+    LightEvent_Init(&prefetch->ready, RESET_ONESHOT);
+    prefetch->stop = false;
+    prefetch->first_block = nwa->curblock;
+    prefetch->decoded = 0;
+    prefetch->generation = 0;
+    // the last block holds restsize samples instead
+    const int block_size = std::max(nwa->blocksize, nwa->restsize);
+    for (auto& slot : prefetch->blocks)
+    {
+        slot.samples.resize(block_size);
+        slot.sample_count = 0;
+    }
+
+    // only worth it on a core the decoding thread isn't on, the 3DS doesn't time slice threads of equal priority
+    s32 prio = 0;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    prefetch->thread = threadCreate(prefetch_main, prefetch, NWA_PREFETCH_STACK_SIZE, prio, 2, false);
+    if (!prefetch->thread)
+        prefetch->thread = threadCreate(prefetch_main, prefetch, NWA_PREFETCH_STACK_SIZE, prio, 1, false);
+    if (!prefetch->thread)
+    {
+        close_nwa(worker_nwa);
+        delete prefetch;
+        return NULL;
+    }
+    return prefetch;
+}
+
+void nwa_prefetch_close(nwa_prefetch* prefetch)
+{
+    if (!prefetch)
+        return;
+
+    LightLock_Lock(&prefetch->lock);
+    prefetch->stop = true;
+    LightLock_Unlock(&prefetch->lock);
+    LightEvent_Signal(&prefetch->work);
+    threadJoin(prefetch->thread, U64_MAX);
+    threadFree(prefetch->thread);
+
+    close_nwa(prefetch->nwa);
+    delete prefetch;
+}
+
+#else
+nwa_prefetch* nwa_prefetch_open(NWAData* nwa)
+{
+    return NULL;
+}
+
+void nwa_prefetch_close(nwa_prefetch* prefetch)
+{
+}
+#endif
+
+void nwa_prefetch_next_block(nwa_prefetch* prefetch, NWAData* nwa)
+{
+    const int block = nwa->curblock;
+    // past the end is left to the library like before
+    if (!prefetch || block < 0 || block >= nwa->blocks)
+    {
+        decode_nwa_block(nwa, block);
+        return;
+    }
+
+#ifdef _3DS
+    LightLock_Lock(&prefetch->lock);
+    if (block != prefetch->first_block)
+    {
+        // seeked or looped, start over from here
+        prefetch->first_block = block;
+        prefetch->decoded = 0;
+        prefetch->generation++;
+        LightEvent_Signal(&prefetch->work);
+    }
+    while (prefetch->decoded == 0)
+    {
+        LightLock_Unlock(&prefetch->lock);
+        LightEvent_Wait(&prefetch->ready);
+        LightLock_Lock(&prefetch->lock);
+    }
+
+    const nwa_prefetch_block& slot = prefetch->blocks[block % NWA_PREFETCH_BLOCKS];
+    memcpy(nwa->buffer, slot.samples.data(), slot.sample_count * sizeof(sample));
+    nwa->samples_in_buffer = slot.sample_count;
+    nwa->buffer_readpos = nwa->buffer;
+    nwa->curblock = block + 1;
+
+    prefetch->first_block++;
+    prefetch->decoded--;
+    LightLock_Unlock(&prefetch->lock);
+    LightEvent_Signal(&prefetch->work);
+#endif
+}
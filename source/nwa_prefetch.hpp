@@ -0,0 +1,30 @@
+#ifndef NWA_PREFETCH_HPP
+#define NWA_PREFETCH_HPP
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+/** Decodes the NWA blocks after the one being played on a worker thread.
+  * NWA blocks decode independently (every block starts from its own
+  * predictor values), so the worker runs its own NWAData on the same file
+  * and hands finished blocks over through a small ring.
+  */
+struct nwa_prefetch;
+
+/** Starts a worker for nwa, which must not be closed before the worker is.
+  * Returns NULL if the file or the thread couldn't be opened, blocks are then decoded in place.
+  */
+nwa_prefetch* nwa_prefetch_open(NWAData* nwa);
+
+/// Stops the worker and closes its NWAData, NULL is ignored.
+void nwa_prefetch_close(nwa_prefetch* prefetch);
+
+/** Loads block nwa->curblock into nwa's buffer and moves on to the next block,
+  * what decode_nwa's nwa_decode_block does. Takes the block from the worker when
+  * prefetch has it (waiting for it if it's being decoded), decodes it in place otherwise.
+  */
+void nwa_prefetch_next_block(nwa_prefetch* prefetch, NWAData* nwa);
+
+#endif
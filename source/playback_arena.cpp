@@ -0,0 +1,38 @@
+#include "playback_arena.hpp"
+
+void playback_arena_init(playback_arena* arena, void* memory, size_t size)
+{
+    arena->base = static_cast<uint8_t*>(memory);
+    arena->size = memory ? size : 0;
+    arena->used = 0;
+    arena->high_water = 0;
+}
+
+size_t playback_arena_footprint(size_t size)
+{
+    return (size + PLAYBACK_ARENA_ALIGNMENT - 1) & ~static_cast<size_t>(PLAYBACK_ARENA_ALIGNMENT - 1);
+}
+
+void* playback_arena_alloc(playback_arena* arena, size_t size)
+{
+    size_t footprint = playback_arena_footprint(size);
+    // also catches size overflowing the rounding
+    if (footprint < size || footprint > arena->size - arena->used)
+        return NULL;
+
+    void* memory = arena->base + arena->used;
+    arena->used += footprint;
+    if (arena->used > arena->high_water)
+        arena->high_water = arena->used;
+    return memory;
+}
+
+size_t playback_arena_available(const playback_arena* arena)
+{
+    return arena->size - arena->used;
+}
+
+void playback_arena_reset(playback_arena* arena)
+{
+    arena->used = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef PLAYBACK_ARENA_HPP
+#define PLAYBACK_ARENA_HPP
+
+#include <cstddef>
+#include <stdint.h>
+
+/** Hands out the playback buffers of a song from one block reserved at
+  * start-up, so songs with different channel counts don't fragment the linear
+  * heap. Everything handed out is released at once by playback_arena_reset
+  * when the song changes. The arena only manages the block it is given, where
+  * that comes from is up to the caller.
+  */
+struct playback_arena
+{
+    uint8_t* base;
+    size_t size;
+    /// Bytes handed out since the last reset.
+    size_t used;
+    /// Most bytes handed out at once since playback_arena_init.
+    size_t high_water;
+};
+
+/// Allocations are aligned like linearAlloc's so the dsp cache can be flushed per buffer.
+#define PLAYBACK_ARENA_ALIGNMENT 0x80
+
+/// Manages size bytes at memory, which must be aligned to PLAYBACK_ARENA_ALIGNMENT. memory may be NULL if size is 0.
+void playback_arena_init(playback_arena* arena, void* memory, size_t size);
+
+/// Returns size bytes from the arena, NULL if they don't fit in what's left.
+void* playback_arena_alloc(playback_arena* arena, size_t size);
+
+/// Bytes a playback_arena_alloc of size takes up, alignment included.
+size_t playback_arena_footprint(size_t size);
+
+/// Bytes still free for playback_arena_alloc.
+size_t playback_arena_available(const playback_arena* arena);
+
+/// Releases everything handed out, the high water mark is kept.
+void playback_arena_reset(playback_arena* arena);
+
+#endif
@@ -0,0 +1,227 @@
+#include "probe_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _3DS
+#include <3ds.h>
+#else
+#include <mutex>
+#endif
+
+#include "detect.hpp"
+
+#define PROBE_CACHE_VERSION 2
+
+struct probe_cache_header
+{
+    char magic[4];
+    uint32_t version;
+    /// detect_probe_count() of the build that wrote it, probe indexes are meaningless otherwise
+    uint32_t probe_count;
+    uint32_t record_size;
+};
+
+struct probe_cache_record
+{
+    uint64_t path_hash;
+    uint64_t mtime;
+    uint32_t size;
+    vgmstream_info info;
+};
+
+static std::unordered_map<uint64_t, probe_cache_record> cache;
+static std::string cache_path;
+
+// the library indexer probes files while the ui opens them
+#ifdef _3DS
+static LightLock cache_lock;
+
+struct cache_guard
+{
+    cache_guard() { LightLock_Lock(&cache_lock); }
+    ~cache_guard() { LightLock_Unlock(&cache_lock); }
+};
+#else
+static std::mutex cache_lock;
+
+struct cache_guard
+{
+    std::lock_guard<std::mutex> guard{cache_lock};
+};
+#endif
+
+static uint64_t hash_path(const char* path)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (; *path; path++)
+    {
+        hash ^= static_cast<uint8_t>(*path);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool get_file_stamp(const char* filename, uint32_t* size, uint64_t* mtime)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0)
+        return false;
+
+    *size = st.st_size;
+#ifdef _3DS
+    // stat on the sd card leaves the times empty
+    if (R_FAILED(sdmc_getmtime(filename, mtime)))
+        *mtime = 0;
+#else
+    *mtime = st.st_mtime;
+#endif
+    return true;
+}
+
+static void make_header(probe_cache_header* header)
+{
+    memcpy(header->magic, "VGPC", 4);
+    header->version = PROBE_CACHE_VERSION;
+    header->probe_count = detect_probe_count();
+    header->record_size = sizeof(probe_cache_record);
+}
+
+static void make_parent_dirs(const std::string& path)
+{
+    for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1))
+        mkdir(path.substr(0, pos).c_str(), 0777);
+}
+
+/// Rewrites the cache file with only the live entries.
+static void write_cache(void)
+{
+    make_parent_dirs(cache_path);
+    FILE* file = fopen(cache_path.c_str(), "wb");
+    if (!file)
+        return;
+
+    probe_cache_header header;
+    make_header(&header);
+    fwrite(&header, sizeof(header), 1, file);
+    for (const auto& entry : cache)
+        fwrite(&entry.second, sizeof(entry.second), 1, file);
+    fclose(file);
+}
+
+void get_vgmstream_info(const VGMSTREAM* vgmstream, int probe, vgmstream_info* info)
+{
+    memset(info, 0, sizeof(vgmstream_info));
+    info->probe = probe;
+    info->meta_type = vgmstream->meta_type;
+    info->coding_type = vgmstream->coding_type;
+    info->layout_type = vgmstream->layout_type;
+    info->channels = vgmstream->channels;
+    info->loop_flag = vgmstream->loop_flag;
+    info->sample_rate = vgmstream->sample_rate;
+    info->num_samples = vgmstream->num_samples;
+    info->loop_start_sample = vgmstream->loop_start_sample;
+    info->loop_end_sample = vgmstream->loop_end_sample;
+    if (vgmstream->coding_type == coding_CRI_ADX_enc_8 || vgmstream->coding_type == coding_CRI_ADX_enc_9)
+    {
+        // the first channel's key as opened, decoding steps it
+        info->adx_key[0] = vgmstream->start_ch[0].adx_xor;
+        info->adx_key[1] = vgmstream->start_ch[0].adx_mult;
+        info->adx_key[2] = vgmstream->start_ch[0].adx_add;
+    }
+}
+
+void probe_cache_load(const char* path)
+{
+#ifdef _3DS
+    LightLock_Init(&cache_lock);
+#endif
+    cache_guard guard;
+    cache.clear();
+    cache_path = path;
+
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path, "rb");
+    if (file)
+    {
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (size > 0)
+        {
+            data.resize(size);
+            if (fread(data.data(), 1, size, file) != static_cast<size_t>(size))
+                data.clear();
+        }
+        fclose(file);
+    }
+
+    probe_cache_header expected;
+    make_header(&expected);
+    if (data.size() < sizeof(probe_cache_header) || memcmp(data.data(), &expected, sizeof(expected)))
+    {
+        // stale or missing, start over
+        write_cache();
+        return;
+    }
+
+    // records are appended as files get opened, the last one for a path wins
+    size_t records = (data.size() - sizeof(probe_cache_header)) / sizeof(probe_cache_record);
+    for (size_t i = 0; i < records; i++)
+    {
+        probe_cache_record record;
+        memcpy(&record, data.data() + sizeof(probe_cache_header) + i * sizeof(probe_cache_record), sizeof(record));
+        cache[record.path_hash] = record;
+    }
+
+    // mostly overwritten entries, shrink it
+    if (records > 2 * cache.size() + 64)
+        write_cache();
+}
+
+bool probe_cache_find(const char* filename, vgmstream_info* info)
+{
+    cache_guard guard;
+    auto it = cache.find(hash_path(filename));
+    if (it == cache.end())
+        return false;
+
+    uint32_t size;
+    uint64_t mtime;
+    if (!get_file_stamp(filename, &size, &mtime) || size != it->second.size || mtime != it->second.mtime)
+    {
+        cache.erase(it);
+        return false;
+    }
+
+    *info = it->second.info;
+    return true;
+}
+
+void probe_cache_store(const char* filename, const vgmstream_info* info)
+{
+    probe_cache_record record;
+    memset(&record, 0, sizeof(record));
+    record.path_hash = hash_path(filename);
+    if (!get_file_stamp(filename, &record.size, &record.mtime))
+        return;
+    record.info = *info;
+
+    cache_guard guard;
+    cache[record.path_hash] = record;
+
+    if (cache_path.empty())
+        return;
+
+    FILE* file = fopen(cache_path.c_str(), "ab");
+    if (!file)
+        return;
+    fwrite(&record, sizeof(record), 1, file);
+    fclose(file);
+}
@@ -0,0 +1,47 @@
+#ifndef PROBE_CACHE_HPP
+#define PROBE_CACHE_HPP
+
+#include <stdint.h>
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+/// What format detection found out about a file.
+struct vgmstream_info
+{
+    /// Probe table index of the meta that opened the file, see detect_stats::winner.
+    int16_t probe;
+    uint16_t meta_type;
+    uint8_t coding_type;
+    uint8_t layout_type;
+    uint8_t channels;
+    uint8_t loop_flag;
+    int32_t sample_rate;
+    int32_t num_samples;
+    int32_t loop_start_sample;
+    int32_t loop_end_sample;
+    /// Encrypted ADX only, the xor, mult and add key init_vgmstream_adx searched the file for.
+    uint16_t adx_key[3];
+};
+
+/// Fills info from an opened stream, probe being the index of the probe that opened it.
+void get_vgmstream_info(const VGMSTREAM* vgmstream, int probe, vgmstream_info* info);
+
+/** Loads the cache file at path in one read, entries written by a build with a
+  * different probe table are dropped. Missing or corrupt files give an empty cache.
+  * Must be called before any other probe_cache function, those are thread safe.
+  */
+void probe_cache_load(const char* path);
+
+/// Looks filename up, only returns true if its size and modification time match the cached ones.
+bool probe_cache_find(const char* filename, vgmstream_info* info);
+
+/// Adds or replaces the entry for filename, it is appended to the cache file right away.
+void probe_cache_store(const char* filename, const vgmstream_info* info);
+
+/// Size and modification time cache entries are validated with, false if filename can't be stat'ed.
+bool get_file_stamp(const char* filename, uint32_t* size, uint64_t* mtime);
+
+#endif
@@ -0,0 +1,323 @@
+#include "probe_info.hpp"
+
+#include <cstring>
+#include <vector>
+
+extern "C"
+{
+    #include <clHCA.h>
+    #include <meta/meta.h>
+}
+
+#include "detect.hpp"
+
+typedef bool (*header_parser)(STREAMFILE*, vgmstream_info*);
+
+/// Mirrors init_vgmstream_bcstm, including which files it turns down and its IMA loop fixup.
+static bool parse_bcstm(STREAMFILE* streamfile, vgmstream_info* info)
+{
+    if (read_32bitBE(0x00, streamfile) != 0x4353544D) // "CSTM"
+        return false;
+    if (static_cast<uint16_t>(read_16bitLE(0x04, streamfile)) != 0xFEFF)
+        return false;
+
+    // a failed offset read leaves -1 in place and the meta reads on from there
+    off_t info_offset = -1;
+    off_t seek_offset = -1;
+    bool info_found = false;
+    int section_count = read_16bitLE(0x10, streamfile);
+    for (int i = 0; i < section_count; i++)
+    {
+        int16_t section_type = read_16bitLE(0x14 + i * 0x0C, streamfile);
+        if (section_type == 0x4000)
+        {
+            info_offset = read_32bitLE(0x18 + i * 0x0C, streamfile);
+            info_found = true;
+        }
+        else if (section_type == 0x4001)
+            seek_offset = read_32bitLE(0x18 + i * 0x0C, streamfile);
+    }
+    if (!info_found)
+        return false;
+
+    int codec = read_8bit(info_offset + 0x20, streamfile);
+    int loop_flag = read_8bit(info_offset + 0x21, streamfile);
+    int channels = read_8bit(info_offset + 0x22, streamfile);
+
+    bool ima = false;
+    switch (codec)
+    {
+        case 0:
+            info->coding_type = coding_PCM8;
+            break;
+        case 1:
+            info->coding_type = coding_PCM16LE;
+            break;
+        case 2:
+            // the meta tells DSP from IMA by the presence of a SEEK block
+            ima = seek_offset < 0 || read_32bitBE(seek_offset, streamfile) != 0x5345454B; // "SEEK"
+            info->coding_type = ima ? coding_INT_IMA : coding_NGC_DSP;
+            break;
+        default:
+            return false;
+    }
+    if (channels <= 0)
+        return false;
+
+    info->meta_type = meta_CSTM;
+    info->channels = channels;
+    info->loop_flag = loop_flag;
+    info->sample_rate = static_cast<uint16_t>(read_16bitLE(info_offset + 0x24, streamfile));
+    info->num_samples = read_32bitLE(info_offset + 0x2C, streamfile);
+    info->loop_start_sample = read_32bitLE(info_offset + 0x28, streamfile);
+    info->loop_end_sample = info->num_samples;
+    if (ima && info->loop_start_sample > 10000)
+    {
+        info->loop_start_sample -= 5000;
+        info->loop_end_sample -= 5000;
+    }
+
+    if (channels == 1)
+        info->layout_type = layout_none;
+    else
+        info->layout_type = ima ? layout_interleave : layout_interleave_shortblock;
+    return true;
+}
+
+/// Big endian field of an HCA header, 0 past its end like clHCA's bit reader returns.
+static uint32_t get_hca_field(const std::vector<uint8_t>& header, size_t offset, int size)
+{
+    if (offset + size > header.size())
+        return 0;
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++)
+        value = value << 8 | header[offset + i];
+    return value;
+}
+
+/// True if an HCA header chunk id matches, ids have their high bits set in encrypted files.
+static bool is_hca_chunk(const std::vector<uint8_t>& header, size_t offset, uint32_t id)
+{
+    return (get_hca_field(header, offset, 4) & 0x7F7F7F7F) == id;
+}
+
+/** Mirrors init_vgmstream_hca, the header is walked and validated the way
+  * clHCA_Decode does it. That includes its bookkeeping of the bytes left,
+  * which the vbr and ath chunks don't count towards.
+  */
+static bool parse_hca(STREAMFILE* streamfile, vgmstream_info* info)
+{
+    uint8_t base[8];
+    if (read_streamfile(base, 0, sizeof(base), streamfile) != sizeof(base))
+        return false;
+    int header_size = clHCA_isOurFile0(base);
+    if (header_size < static_cast<int>(sizeof(base)))
+        return false;
+
+    std::vector<uint8_t> header(header_size);
+    if (read_streamfile(header.data(), 0, header_size, streamfile) != static_cast<size_t>(header_size))
+        return false;
+    if (clHCA_isOurFile1(header.data(), header_size) < 0)
+        return false;
+
+    unsigned int remaining = header_size - 8;
+    if (remaining < 16 || !is_hca_chunk(header, 0x08, 0x666D7400)) // "fmt\0"
+        return false;
+    unsigned int version = get_hca_field(header, 0x04, 2);
+    unsigned int channels = header[0x0C];
+    unsigned int sample_rate = get_hca_field(header, 0x0D, 3);
+    unsigned int block_count = get_hca_field(header, 0x10, 4);
+    if (channels < 1 || channels > 16)
+        return false;
+    if (sample_rate < 1 || sample_rate > 0x7FFFFF)
+        return false;
+    size_t chunk = 0x18;
+    remaining -= 16;
+
+    unsigned int block_size, r01, r02;
+    if (remaining >= 16 && is_hca_chunk(header, chunk, 0x636F6D70)) // "comp"
+    {
+        block_size = get_hca_field(header, chunk + 4, 2);
+        r01 = get_hca_field(header, chunk + 6, 1);
+        r02 = get_hca_field(header, chunk + 7, 1);
+        chunk += 16;
+        remaining -= 16;
+    }
+    else if (remaining >= 12 && is_hca_chunk(header, chunk, 0x64656300)) // "dec\0"
+    {
+        block_size = get_hca_field(header, chunk + 4, 2);
+        r01 = get_hca_field(header, chunk + 6, 1);
+        r02 = get_hca_field(header, chunk + 7, 1);
+        chunk += 12;
+        remaining -= 12;
+    }
+    else
+        return false;
+    if (r01 > r02 || r02 > 31)
+        return false;
+    if (block_size != 0 && block_size < 8)
+        return false;
+
+    if (remaining >= 8 && is_hca_chunk(header, chunk, 0x76627200)) // "vbr\0"
+    {
+        if (block_size != 0 || get_hca_field(header, chunk + 4, 2) >= 0x200)
+            return false;
+        chunk += 8;
+    }
+
+    unsigned int ath_type = version < 0x200 ? 1 : 0;
+    if (remaining >= 6 && is_hca_chunk(header, chunk, 0x61746800)) // "ath\0"
+    {
+        ath_type = get_hca_field(header, chunk + 4, 2);
+        chunk += 6;
+    }
+
+    info->loop_flag = 0;
+    info->loop_start_sample = 0;
+    info->loop_end_sample = 0;
+    if (remaining >= 16 && is_hca_chunk(header, chunk, 0x6C6F6F70)) // "loop"
+    {
+        uint32_t loop_start = get_hca_field(header, chunk + 4, 4);
+        uint32_t loop_end = get_hca_field(header, chunk + 8, 4);
+        if (loop_start > loop_end || loop_end >= block_count)
+            return false;
+        info->loop_flag = 1;
+        info->loop_start_sample = loop_start * clHCA_samplesPerBlock;
+        info->loop_end_sample = loop_end * clHCA_samplesPerBlock;
+        chunk += 16;
+        remaining -= 16;
+    }
+
+    if (remaining >= 6 && is_hca_chunk(header, chunk, 0x63697068)) // "ciph"
+    {
+        unsigned int cipher_type = get_hca_field(header, chunk + 4, 2);
+        if (cipher_type != 0 && cipher_type != 1 && cipher_type != 56)
+            return false;
+        chunk += 6;
+        remaining -= 6;
+    }
+
+    if (remaining >= 8 && is_hca_chunk(header, chunk, 0x72766100)) // "rva\0"
+    {
+        chunk += 8;
+        remaining -= 8;
+    }
+
+    if (remaining >= 5 && is_hca_chunk(header, chunk, 0x636F6D6D)) // "comm"
+    {
+        if (get_hca_field(header, chunk + 4, 1) > remaining)
+            return false;
+    }
+
+    // only the parameters the decoder is built for
+    if (ath_type > 1 || r01 != 1 || r02 != 15)
+        return false;
+
+    info->meta_type = meta_HCA;
+    info->coding_type = coding_CRI_HCA;
+    info->layout_type = layout_none;
+    info->channels = channels;
+    info->sample_rate = sample_rate;
+    info->num_samples = block_count * clHCA_samplesPerBlock;
+    return true;
+}
+
+#ifdef VGM_USE_MPEG
+/** Mirrors init_vgmstream_ahx. The sample count is in the header so nothing is
+  * scanned, and mpg123 isn't started either, the meta only opens a feed without decoding.
+  * No meta of this libvgmstream opens raw MP3, so there are no Xing, Info or VBRI
+  * headers or frame scans to take durations from, AHX and FSB carry their own.
+  */
+static bool parse_ahx(STREAMFILE* streamfile, vgmstream_info* info)
+{
+    if (static_cast<uint16_t>(read_16bitBE(0x00, streamfile)) != 0x8000)
+        return false;
+    uint16_t header_size = read_16bitBE(0x02, streamfile);
+    if (static_cast<uint16_t>(read_16bitBE(header_size - 2, streamfile)) != 0x2863) // "(c"
+        return false;
+    if (read_32bitBE(header_size, streamfile) != 0x29435249) // ")CRI"
+        return false;
+    // type, frame size, bits per sample, channels
+    if (read_8bit(0x04, streamfile) != 0x11 || read_8bit(0x05, streamfile) != 0 ||
+        read_8bit(0x06, streamfile) != 0 || read_8bit(0x07, streamfile) != 1)
+        return false;
+
+    info->meta_type = meta_AHX;
+    info->coding_type = coding_fake_MPEG2_L2;
+    info->layout_type = layout_fake_mpeg;
+    info->channels = 1;
+    info->loop_flag = 0;
+    info->sample_rate = read_32bitBE(0x08, streamfile);
+    info->num_samples = read_32bitBE(0x0C, streamfile);
+    return true;
+}
+#endif
+
+/// Probes with a header parser that accepts and rejects exactly the same files.
+static const struct
+{
+    VGMSTREAM* (*probe)(STREAMFILE*);
+    header_parser parse;
+} header_parsers[] =
+{
+    {init_vgmstream_bcstm, parse_bcstm},
+    {init_vgmstream_hca, parse_hca},
+#ifdef VGM_USE_MPEG
+    {init_vgmstream_ahx, parse_ahx},
+#endif
+};
+
+static header_parser find_parser(int probe)
+{
+    for (const auto& parser : header_parsers)
+    {
+        if (detect_find_probe(parser.probe) == probe)
+            return parser.parse;
+    }
+    return NULL;
+}
+
+bool parse_vgmstream_info(STREAMFILE* streamfile, vgmstream_info* info)
+{
+    int candidates[DETECT_MAX_CANDIDATES];
+    int count = detect_candidates(streamfile, candidates);
+    for (int i = 0; i < count; i++)
+    {
+        // an unparsed candidate could be the one that wins, only opening it tells
+        header_parser parse = find_parser(candidates[i]);
+        if (!parse)
+            return false;
+
+        memset(info, 0, sizeof(vgmstream_info));
+        if (parse(streamfile, info) && check_sample_rate(info->sample_rate))
+        {
+            info->probe = candidates[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool probe_vgmstream_info(STREAMFILE* streamfile, vgmstream_info* info)
+{
+    if (!streamfile)
+        return false;
+
+    char filename[PATH_LIMIT];
+    streamfile->get_name(streamfile, filename, sizeof(filename));
+    if (probe_cache_find(filename, info))
+        return true;
+
+    if (!parse_vgmstream_info(streamfile, info))
+    {
+        detect_stats stats;
+        VGMSTREAM* vgmstream = detect_vgmstream(streamfile, &stats);
+        if (!vgmstream)
+            return false;
+        get_vgmstream_info(vgmstream, stats.winner, info);
+        close_vgmstream(vgmstream);
+    }
+
+    probe_cache_store(filename, info);
+    return true;
+}
@@ -0,0 +1,20 @@
+#ifndef PROBE_INFO_HPP
+#define PROBE_INFO_HPP
+
+#include "probe_cache.hpp"
+
+/** Fills info about the file streamfile was opened on without decoding anything.
+  * The probe cache is tried first, then formats whose header alone tells
+  * everything are parsed directly, anything else is opened with
+  * detect_vgmstream and closed right away. Results that weren't cached get stored.
+  * Returns false if vgmstream can't play the file.
+  */
+bool probe_vgmstream_info(STREAMFILE* streamfile, vgmstream_info* info);
+
+/** Header only part of probe_vgmstream_info, never calls an init_vgmstream_* probe.
+  * Returns false if the file isn't one of the parsed formats, in which case it
+  * has to be opened to find out.
+  */
+bool parse_vgmstream_info(STREAMFILE* streamfile, vgmstream_info* info);
+
+#endif
@@ -0,0 +1,670 @@
+#include "render.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+extern "C"
+{
+    #include <layout/layout.h>
+}
+
+#include "acm_prefetch.hpp"
+#include "render_pool.hpp"
+#include "streamfile_ext.hpp"
+
+/// Samples per channel decoded at once when seek_planar decodes up to the target.
+#define SEEK_DECODE_SAMPLES 0x400
+/// Samples per channel of child streams left to render_vgmstream, rendered at once into the scratch buffer.
+#define CHILD_SCRATCH_SAMPLES 0x400
+/// Most worker threads child streams are rendered on besides the decoding thread.
+#define CHILD_WORKERS 2
+
+/// Everything a child stream renders with, children can be rendered on different threads at once.
+struct child_stream
+{
+    VGMSTREAM* stream;
+    stream_renderer renderer;
+    /// Its first channel in the parent stream.
+    int first_channel;
+    /// Where its channels go in the current call.
+    std::vector<sample*> channels;
+    /// Only if it's left to render_vgmstream, CHILD_SCRATCH_SAMPLES for each of its channels.
+    std::vector<sample> scratch;
+};
+
+/// The child streams of an AIX, AAX or SCD interleave stream, in the order of its codec data.
+struct child_streams
+{
+    std::vector<child_stream> streams;
+    /// NULL if the children are rendered one after another.
+    render_pool* pool;
+
+    /// What render_children was called with, for the jobs.
+    int first;
+    sample** channels;
+    int32_t samples_written;
+    int32_t sample_count;
+};
+
+/// render_vgmstream_blocked marks the stream as over instead of going past the last block.
+static void update_halpst_block(off_t block_offset, VGMSTREAM* vgmstream)
+{
+    if (block_offset < 0)
+        vgmstream->current_block_offset = -1;
+    else
+        halpst_block_update(block_offset, vgmstream);
+}
+
+/// Blocked layouts render_vgmstream_blocked handles, the rest go to render_vgmstream.
+static const struct
+{
+    layout_t layout;
+    block_updater update;
+} block_layouts[] =
+{
+    {layout_ast_blocked, ast_block_update},
+    {layout_halpst_blocked, update_halpst_block},
+    {layout_xa_blocked, xa_block_update},
+    {layout_ea_blocked, ea_block_update},
+    {layout_eacs_blocked, eacs_block_update},
+    {layout_caf_blocked, caf_block_update},
+    {layout_wsi_blocked, wsi_block_update},
+    {layout_str_snds_blocked, str_snds_block_update},
+    {layout_ws_aud_blocked, ws_aud_block_update},
+    {layout_matx_blocked, matx_block_update},
+    {layout_de2_blocked, de2_block_update},
+    {layout_xvas_blocked, xvas_block_update},
+    {layout_vs_blocked, vs_block_update},
+    {layout_emff_ps2_blocked, emff_ps2_block_update},
+    {layout_emff_ngc_blocked, emff_ngc_block_update},
+    {layout_gsb_blocked, gsb_block_update},
+    {layout_thp_blocked, thp_block_update},
+    {layout_filp_blocked, filp_block_update},
+    {layout_psx_mgav_blocked, psx_mgav_block_update},
+    {layout_ps2_adm_blocked, ps2_adm_block_update},
+    {layout_dsp_bdsp_blocked, dsp_bdsp_block_update},
+    {layout_mxch_blocked, mxch_block_update},
+    {layout_ivaud_blocked, ivaud_block_update},
+    {layout_tra_blocked, tra_block_update},
+    {layout_ps2_iab_blocked, ps2_iab_block_update},
+    {layout_ps2_strlr_blocked, ps2_strlr_block_update},
+};
+
+/// decode_vgmstream for native codings, samples_to_do may cross frames.
+static void decode_planar(VGMSTREAM* vgmstream, const frame_decoder* decoder, sample** channels, int32_t samples_written, int32_t samples_to_do)
+{
+    if (decoder->stream)
+    {
+        decoder->stream(vgmstream, decoder->stream_data, channels, samples_written, samples_to_do);
+        return;
+    }
+
+    for (int chan = 0; chan < vgmstream->channels; chan++)
+        decode_frames(decoder, &vgmstream->ch[chan], channels[chan] + samples_written, vgmstream->samples_into_block, samples_to_do);
+}
+
+/** What vgmstream_samples_to_do gives minus its limit of one frame per call,
+  * the decoders don't need it. Still stops at loop points and the end of the block.
+  */
+static int32_t get_samples_to_do(VGMSTREAM* vgmstream, int samples_this_block, int32_t samples_written, int32_t sample_count)
+{
+    return std::min(vgmstream_samples_to_do(samples_this_block, 1, vgmstream), sample_count - samples_written);
+}
+
+/// Past the end of a stream that doesn't loop, render_vgmstream would never return there.
+static void pad_planar(VGMSTREAM* vgmstream, sample** channels, int32_t samples_written, int32_t sample_count)
+{
+    for (int chan = 0; chan < vgmstream->channels; chan++)
+        memset(channels[chan] + samples_written, 0, (sample_count - samples_written) * sizeof(sample));
+}
+
+/// render_vgmstream_nolayout
+static void render_nolayout_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, sample** channels, int32_t sample_count)
+{
+    int32_t samples_written = 0;
+    while (samples_written < sample_count)
+    {
+        if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream))
+            continue;
+
+        int32_t samples_to_do = get_samples_to_do(vgmstream, vgmstream->num_samples, samples_written, sample_count);
+        if (samples_to_do <= 0)
+        {
+            pad_planar(vgmstream, channels, samples_written, sample_count);
+            return;
+        }
+
+        decode_planar(vgmstream, &renderer->decoder, channels, samples_written, samples_to_do);
+        samples_written += samples_to_do;
+        vgmstream->current_sample += samples_to_do;
+        vgmstream->samples_into_block += samples_to_do;
+    }
+}
+
+/// Lets the streamfiles of vgmstream's channels read length bytes at offset ahead, each one once.
+static void hint_channels(VGMSTREAM* vgmstream, off_t offset, size_t length)
+{
+    for (int chan = 0; chan < vgmstream->channels; chan++)
+    {
+        STREAMFILE* streamfile = vgmstream->ch[chan].streamfile;
+        // channels may share a streamfile
+        bool seen = false;
+        for (int i = 0; i < chan && !seen; i++)
+            seen = vgmstream->ch[i].streamfile == streamfile;
+        if (!seen)
+            hint_streamfile(streamfile, offset, length);
+    }
+}
+
+/// Samples in one interleave block, a short one if shortblock.
+static int get_interleave_block_samples(VGMSTREAM* vgmstream, bool shortblock)
+{
+    if (shortblock)
+        return vgmstream->interleave_smallblock_size / get_vgmstream_shortframe_size(vgmstream) * get_vgmstream_samples_per_shortframe(vgmstream);
+    return vgmstream->interleave_block_size / get_vgmstream_frame_size(vgmstream) * get_vgmstream_samples_per_frame(vgmstream);
+}
+
+/// render_vgmstream_interleave, also for layout_interleave_shortblock.
+static void render_interleave_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, sample** channels, int32_t sample_count)
+{
+    const bool has_shortblock = vgmstream->layout_type == layout_interleave_shortblock;
+    int samples_this_block = renderer->block_samples;
+    if (has_shortblock && vgmstream->current_sample - vgmstream->samples_into_block + samples_this_block > vgmstream->num_samples)
+        samples_this_block = renderer->shortblock_samples;
+
+    int32_t samples_written = 0;
+    while (samples_written < sample_count)
+    {
+        if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream))
+        {
+            // the loop is assumed not to go back into the short block
+            samples_this_block = renderer->block_samples;
+            continue;
+        }
+
+        int32_t samples_to_do = get_samples_to_do(vgmstream, samples_this_block, samples_written, sample_count);
+        if (samples_to_do <= 0)
+        {
+            pad_planar(vgmstream, channels, samples_written, sample_count);
+            return;
+        }
+
+        decode_planar(vgmstream, &renderer->decoder, channels, samples_written, samples_to_do);
+        samples_written += samples_to_do;
+        vgmstream->current_sample += samples_to_do;
+        vgmstream->samples_into_block += samples_to_do;
+
+        if (vgmstream->samples_into_block == samples_this_block)
+        {
+            if (has_shortblock && vgmstream->current_sample + samples_this_block > vgmstream->num_samples)
+            {
+                samples_this_block = renderer->shortblock_samples;
+                for (int chan = 0; chan < vgmstream->channels; chan++)
+                    vgmstream->ch[chan].offset += vgmstream->interleave_block_size * (vgmstream->channels - chan) + vgmstream->interleave_smallblock_size * chan;
+            }
+            else
+            {
+                for (int chan = 0; chan < vgmstream->channels; chan++)
+                    vgmstream->ch[chan].offset += vgmstream->interleave_block_size * vgmstream->channels;
+            }
+            vgmstream->samples_into_block = 0;
+
+            // the channels read the next row of blocks after this one between them, hinted as one range
+            size_t row_size = vgmstream->interleave_block_size * vgmstream->channels;
+            hint_channels(vgmstream, vgmstream->ch[0].offset + row_size, row_size);
+        }
+    }
+}
+
+/// Samples in the current block of a blocked layout.
+static int get_block_samples(VGMSTREAM* vgmstream, const stream_renderer* renderer)
+{
+    // a frame size of 0 stands for 4 bit samples
+    if (renderer->frame_size == 0)
+        return vgmstream->current_block_size * 2 * renderer->decoder.samples_per_frame;
+    return vgmstream->current_block_size / renderer->frame_size * renderer->decoder.samples_per_frame;
+}
+
+/// Adds the block vgmstream is at the start of to the index, blocks already in there are skipped.
+static void index_block(VGMSTREAM* vgmstream, stream_renderer* renderer)
+{
+    std::vector<block_index_entry>& blocks = *renderer->blocks;
+    if (vgmstream->current_block_offset < 0)
+        return;
+    // blocks are only ever entered one after the other, so anything not past the last one is known
+    if (!blocks.empty() && vgmstream->current_sample <= blocks.back().samples_before)
+        return;
+    blocks.push_back({vgmstream->current_block_offset, vgmstream->current_block_size, vgmstream->current_sample});
+}
+
+/// Moves to the block at block_offset, current_sample must already be the samples before it.
+static void update_block(VGMSTREAM* vgmstream, stream_renderer* renderer, off_t block_offset)
+{
+    renderer->block_update(block_offset, vgmstream);
+    // these may change from block to block
+    renderer->frame_size = get_vgmstream_frame_size(vgmstream);
+    renderer->decoder.samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+    vgmstream->samples_into_block = 0;
+    index_block(vgmstream, renderer);
+}
+
+static bool compare_samples_before(int32_t sample, const block_index_entry& entry)
+{
+    return sample < entry.samples_before;
+}
+
+/// Puts vgmstream at the start of the block sample is in, walking on from the last indexed block if needed.
+static void seek_block(VGMSTREAM* vgmstream, stream_renderer* renderer, int32_t sample)
+{
+    const std::vector<block_index_entry>& blocks = *renderer->blocks;
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), sample, compare_samples_before);
+    const block_index_entry entry = it == blocks.begin() ? *it : *(it - 1);
+
+    memcpy(vgmstream->ch, vgmstream->start_ch, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+    vgmstream->current_sample = entry.samples_before;
+    update_block(vgmstream, renderer, entry.offset);
+    const off_t file_size = get_streamfile_size(vgmstream->ch[0].streamfile);
+    while (vgmstream->current_block_offset >= 0)
+    {
+        // stays in the last block of the stream, whatever comes after it isn't a block to decode from
+        int samples_this_block = get_block_samples(vgmstream, renderer);
+        if (samples_this_block <= 0 || vgmstream->current_sample + samples_this_block > sample)
+            break;
+        if (vgmstream->current_sample + samples_this_block >= vgmstream->num_samples)
+            break;
+        if (vgmstream->next_block_offset < 0 || vgmstream->next_block_offset >= file_size)
+            break;
+        vgmstream->current_sample += samples_this_block;
+        update_block(vgmstream, renderer, vgmstream->next_block_offset);
+    }
+}
+
+/// render_vgmstream_blocked
+static void render_blocked_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, sample** channels, int32_t sample_count)
+{
+    int samples_this_block = get_block_samples(vgmstream, renderer);
+
+    int32_t samples_written = 0;
+    while (samples_written < sample_count)
+    {
+        if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream))
+        {
+            samples_this_block = get_block_samples(vgmstream, renderer);
+            continue;
+        }
+
+        int32_t samples_to_do = get_samples_to_do(vgmstream, samples_this_block, samples_written, sample_count);
+        if (vgmstream->current_block_offset >= 0)
+            decode_planar(vgmstream, &renderer->decoder, channels, samples_written, samples_to_do);
+        else if (samples_to_do > 0) // ran off the end of the stream
+            pad_planar(vgmstream, channels, samples_written, samples_written + samples_to_do);
+        samples_written += samples_to_do;
+        vgmstream->current_sample += samples_to_do;
+        vgmstream->samples_into_block += samples_to_do;
+
+        if (vgmstream->samples_into_block == samples_this_block)
+        {
+            update_block(vgmstream, renderer, vgmstream->next_block_offset);
+            samples_this_block = get_block_samples(vgmstream, renderer);
+            // the header of the block after this one is known now, its size isn't but is likely the same
+            if (vgmstream->current_block_offset >= 0)
+                hint_channels(vgmstream, vgmstream->next_block_offset, vgmstream->current_block_size);
+        }
+    }
+}
+
+/// render_vgmstream_mus_acm, moving on to the next file goes through the prefetcher.
+static void render_mus_acm_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, sample** channels, int32_t sample_count)
+{
+    mus_acm_codec_data* data = static_cast<mus_acm_codec_data*>(vgmstream->codec_data);
+    acm_prefetch* prefetch = static_cast<acm_prefetch*>(renderer->decoder.stream_data);
+
+    int32_t samples_written = 0;
+    while (samples_written < sample_count)
+    {
+        ACMStream* acm = data->files[data->current_file];
+        int samples_this_block = acm->total_values / acm->info.channels;
+
+        if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream))
+        {
+            acm_prefetch_switch(prefetch, vgmstream, data->loop_start_file);
+            vgmstream->samples_into_block = 0;
+            continue;
+        }
+
+        int32_t samples_to_do = get_samples_to_do(vgmstream, samples_this_block, samples_written, sample_count);
+        if (samples_to_do == 0)
+        {
+            // past the last file it starts over, loop or not
+            acm_prefetch_switch(prefetch, vgmstream, data->current_file + 1 < data->file_count ? data->current_file + 1 : 0);
+            vgmstream->samples_into_block = 0;
+            continue;
+        }
+
+        decode_planar(vgmstream, &renderer->decoder, channels, samples_written, samples_to_do);
+        samples_written += samples_to_do;
+        vgmstream->current_sample += samples_to_do;
+        vgmstream->samples_into_block += samples_to_do;
+    }
+}
+
+/// Renders what render_children asked for of child first + index into its channels.
+static void render_child(void* arg, int index)
+{
+    child_streams* children = static_cast<child_streams*>(arg);
+    child_stream& child = children->streams[children->first + index];
+    // only render_vgmstream needs scratch space, as much of it as it renders
+    const int32_t samples_per_call = child.renderer.render ? children->sample_count : CHILD_SCRATCH_SAMPLES;
+    for (int32_t samples_done = 0; samples_done < children->sample_count; samples_done += samples_per_call)
+    {
+        for (int chan = 0; chan < child.stream->channels; chan++)
+            child.channels[chan] = children->channels[child.first_channel + chan] + children->samples_written + samples_done;
+        render_planar(child.stream, &child.renderer, child.channels.data(), std::min<int32_t>(samples_per_call, children->sample_count - samples_done), child.scratch.data());
+    }
+}
+
+/// Renders sample_count samples of count children from first on into channels from samples_written on, side by side if they have a pool.
+static void render_children(child_streams* children, int first, int count, sample** channels, int32_t samples_written, int32_t sample_count)
+{
+    children->first = first;
+    children->channels = channels;
+    children->samples_written = samples_written;
+    children->sample_count = sample_count;
+    render_pool_run(children->pool, render_child, children, count);
+}
+
+/// What the AIX and AAX layouts do between segments, the next one picks up the adpcm history of the last one.
+static void carry_history(VGMSTREAM* to, const VGMSTREAM* from, int channels)
+{
+    for (int chan = 0; chan < channels; chan++)
+    {
+        to->ch[chan].adpcm_history1_32 = from->ch[chan].adpcm_history1_32;
+        to->ch[chan].adpcm_history2_32 = from->ch[chan].adpcm_history2_32;
+    }
+}
+
+/// Moves an AIX stream on to segment, its streams carrying on from those of previous_segment.
+static void start_aix_segment(aix_codec_data* data, int segment, int previous_segment)
+{
+    data->current_segment = segment;
+    for (int i = 0; i < data->stream_count; i++)
+    {
+        VGMSTREAM* adx = data->adxs[segment * data->stream_count + i];
+        reset_vgmstream(adx);
+        carry_history(adx, data->adxs[previous_segment * data->stream_count + i], adx->channels);
+    }
+}
+
+/// render_vgmstream_aix, the streams of a segment go straight into their channels instead of through AIX_BUFFER_SIZE at a time.
+static void render_aix_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, sample** channels, int32_t sample_count)
+{
+    aix_codec_data* data = static_cast<aix_codec_data*>(vgmstream->codec_data);
+
+    int32_t samples_written = 0;
+    while (samples_written < sample_count)
+    {
+        int samples_this_block = data->sample_counts[data->current_segment];
+
+        if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream))
+        {
+            // the loop is always the second segment
+            start_aix_segment(data, 1, 0);
+            vgmstream->samples_into_block = 0;
+            continue;
+        }
+
+        int32_t samples_to_do = get_samples_to_do(vgmstream, samples_this_block, samples_written, sample_count);
+        if (samples_to_do == 0)
+        {
+            start_aix_segment(data, data->current_segment + 1, data->current_segment);
+            vgmstream->samples_into_block = 0;
+            continue;
+        }
+
+        render_children(renderer->children, data->current_segment * data->stream_count, data->stream_count, channels, samples_written, samples_to_do);
+        samples_written += samples_to_do;
+        vgmstream->current_sample += samples_to_do;
+        vgmstream->samples_into_block += samples_to_do;
+    }
+}
+
+/// Moves an AAX stream on to segment, carrying on from previous_segment unless it's negative.
+static void start_aax_segment(aax_codec_data* data, int segment, int previous_segment)
+{
+    data->current_segment = segment;
+    reset_vgmstream(data->adxs[segment]);
+    if (previous_segment >= 0)
+        carry_history(data->adxs[segment], data->adxs[previous_segment], data->adxs[0]->channels);
+}
+
+/// render_vgmstream_aax
+static void render_aax_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, sample** channels, int32_t sample_count)
+{
+    aax_codec_data* data = static_cast<aax_codec_data*>(vgmstream->codec_data);
+
+    int32_t samples_written = 0;
+    while (samples_written < sample_count)
+    {
+        int samples_this_block = data->sample_counts[data->current_segment];
+
+        if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream))
+        {
+            start_aax_segment(data, data->loop_segment, data->loop_segment - 1);
+            vgmstream->samples_into_block = 0;
+            continue;
+        }
+
+        int32_t samples_to_do = get_samples_to_do(vgmstream, samples_this_block, samples_written, sample_count);
+        if (samples_to_do == 0)
+        {
+            start_aax_segment(data, data->current_segment + 1, data->current_segment);
+            vgmstream->samples_into_block = 0;
+            continue;
+        }
+
+        render_children(renderer->children, data->current_segment, 1, channels, samples_written, samples_to_do);
+        samples_written += samples_to_do;
+        vgmstream->current_sample += samples_to_do;
+        vgmstream->samples_into_block += samples_to_do;
+    }
+}
+
+/// render_vgmstream_scd_int, the substreams are mono and each one goes straight into its channel.
+static void render_scd_int_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, sample** channels, int32_t sample_count)
+{
+    scd_int_codec_data* data = static_cast<scd_int_codec_data*>(vgmstream->codec_data);
+    render_children(renderer->children, 0, data->substream_count, channels, 0, sample_count);
+}
+
+/// Sets up layouts made of child streams, returns false for any other layout.
+static bool init_child_streams(VGMSTREAM* vgmstream, stream_renderer* renderer)
+{
+    VGMSTREAM** streams;
+    int stream_count;
+    // children rendered at once, their channels follow each other in the parent
+    int group_size;
+    switch (vgmstream->layout_type)
+    {
+        case layout_aix:
+        {
+            aix_codec_data* data = static_cast<aix_codec_data*>(vgmstream->codec_data);
+            streams = data->adxs;
+            stream_count = data->segment_count * data->stream_count;
+            group_size = data->stream_count;
+            renderer->render = render_aix_planar;
+            break;
+        }
+        case layout_aax:
+        {
+            aax_codec_data* data = static_cast<aax_codec_data*>(vgmstream->codec_data);
+            streams = data->adxs;
+            stream_count = data->segment_count;
+            group_size = 1;
+            renderer->render = render_aax_planar;
+            break;
+        }
+        case layout_scd_int:
+        {
+            scd_int_codec_data* data = static_cast<scd_int_codec_data*>(vgmstream->codec_data);
+            streams = data->substreams;
+            stream_count = data->substream_count;
+            group_size = data->substream_count;
+            renderer->render = render_scd_int_planar;
+            break;
+        }
+        default:
+            return false;
+    }
+
+    child_streams* children = new child_streams();
+    children->streams.resize(stream_count);
+    int first_channel = 0;
+    for (int i = 0; i < stream_count; i++)
+    {
+        child_stream& child = children->streams[i];
+        child.stream = streams[i];
+        init_stream_renderer(child.stream, &child.renderer);
+        if (i % group_size == 0)
+            first_channel = 0;
+        child.first_channel = first_channel;
+        first_channel += child.stream->channels;
+        child.channels.resize(child.stream->channels);
+        if (!child.renderer.render)
+            child.scratch.resize(CHILD_SCRATCH_SAMPLES * child.stream->channels);
+    }
+    children->pool = render_pool_open(std::min(group_size - 1, CHILD_WORKERS));
+    renderer->children = children;
+    return true;
+}
+
+void init_stream_renderer(VGMSTREAM* vgmstream, stream_renderer* renderer)
+{
+    memset(renderer, 0, sizeof(*renderer));
+    // these don't decode anything themselves, so don't need a decoder
+    if (init_child_streams(vgmstream, renderer))
+        return;
+    if (!get_frame_decoder(vgmstream, &renderer->decoder))
+        return;
+    renderer->frame_size = get_vgmstream_frame_size(vgmstream);
+
+    switch (vgmstream->layout_type)
+    {
+        case layout_none:
+#ifdef VGM_USE_VORBIS
+        case layout_ogg_vorbis:
+#endif
+            renderer->render = render_nolayout_planar;
+            return;
+        case layout_interleave:
+        case layout_interleave_shortblock:
+            renderer->render = render_interleave_planar;
+            renderer->block_samples = get_interleave_block_samples(vgmstream, false);
+            if (vgmstream->layout_type == layout_interleave_shortblock)
+                renderer->shortblock_samples = get_interleave_block_samples(vgmstream, true);
+            return;
+        case layout_mus_acm:
+            renderer->render = render_mus_acm_planar;
+            return;
+        default:
+            break;
+    }
+
+    for (const auto& entry : block_layouts)
+    {
+        if (entry.layout != vgmstream->layout_type)
+            continue;
+        renderer->render = render_blocked_planar;
+        renderer->block_update = entry.update;
+        renderer->blocks = new std::vector<block_index_entry>();
+        index_block(vgmstream, renderer);
+        return;
+    }
+    // left to render_vgmstream, which doesn't use the decoder's stream data
+    close_frame_decoder(&renderer->decoder);
+}
+
+void close_stream_renderer(stream_renderer* renderer)
+{
+    close_frame_decoder(&renderer->decoder);
+    delete renderer->blocks;
+    renderer->blocks = NULL;
+    if (renderer->children)
+    {
+        render_pool_close(renderer->children->pool);
+        for (auto& child : renderer->children->streams)
+            close_stream_renderer(&child.renderer);
+        delete renderer->children;
+        renderer->children = NULL;
+    }
+    renderer->render = NULL;
+}
+
+void render_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, sample** channels, int32_t sample_count, sample* scratch)
+{
+    if (renderer->render)
+    {
+        renderer->render(vgmstream, renderer, channels, sample_count);
+        return;
+    }
+
+    render_vgmstream(scratch, sample_count, vgmstream);
+    const int channel_count = vgmstream->channels;
+    for (int chan = 0; chan < channel_count; chan++)
+    {
+        sample* out = channels[chan];
+        const sample* in = scratch + chan;
+        for (int32_t i = 0; i < sample_count; i++, in += channel_count)
+            out[i] = *in;
+    }
+}
+
+const VGMSTREAM* get_position_stream(const VGMSTREAM* vgmstream)
+{
+    if (vgmstream->layout_type == layout_scd_int)
+        return static_cast<const scd_int_codec_data*>(vgmstream->codec_data)->substreams[0];
+    return vgmstream;
+}
+
+void seek_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, int32_t target_sample)
+{
+    if (vgmstream->loop_flag && target_sample >= vgmstream->loop_end_sample)
+    {
+        int32_t loop_samples = vgmstream->loop_end_sample - vgmstream->loop_start_sample;
+        target_sample = vgmstream->loop_start_sample + (target_sample - vgmstream->loop_start_sample) % loop_samples;
+    }
+    // the last sample at most, past it there's nothing to seek to
+    target_sample = std::max<int32_t>(0, std::min<int32_t>(target_sample, vgmstream->num_samples - 1));
+
+    // vgmstream_do_loop only saves the loop start when decoding through it
+    const VGMSTREAM* position = get_position_stream(vgmstream);
+    int32_t block_sample = target_sample;
+    if (vgmstream->loop_flag && !position->hit_loop)
+        block_sample = std::min<int32_t>(target_sample, vgmstream->loop_start_sample);
+
+    if (renderer->blocks && !renderer->blocks->empty())
+    {
+        seek_block(vgmstream, renderer, block_sample);
+    }
+    else if (block_sample < position->current_sample)
+    {
+        // no way back but from the start, the decoder's stream data goes with it
+        close_stream_renderer(renderer);
+        reset_vgmstream(vgmstream);
+        init_stream_renderer(vgmstream, renderer);
+    }
+
+    const int channel_count = vgmstream->channels;
+    std::vector<sample> discard(SEEK_DECODE_SAMPLES * channel_count * 2);
+    std::vector<sample*> channels(channel_count);
+    for (int chan = 0; chan < channel_count; chan++)
+        channels[chan] = discard.data() + chan * SEEK_DECODE_SAMPLES;
+    sample* scratch = discard.data() + SEEK_DECODE_SAMPLES * channel_count;
+
+    int32_t samples_left = target_sample - position->current_sample;
+    while (samples_left > 0)
+    {
+        int32_t samples_to_do = std::min<int32_t>(samples_left, SEEK_DECODE_SAMPLES);
+        render_planar(vgmstream, renderer, channels.data(), samples_to_do, scratch);
+        samples_left -= samples_to_do;
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+#include <vector>
+
+#include "decoders.hpp"
+
+struct stream_renderer;
+struct child_streams;
+
+/// Where a block of a blocked layout starts, what block_update needs to go back there.
+struct block_index_entry
+{
+    off_t offset;
+    size_t size;
+    /// current_sample at the start of the block.
+    int32_t samples_before;
+};
+
+typedef void (*layout_renderer)(VGMSTREAM* vgmstream, stream_renderer* renderer, sample** channels, int32_t sample_count);
+typedef void (*block_updater)(off_t block_offset, VGMSTREAM* vgmstream);
+
+/** How render_planar renders a stream, resolved once by init_stream_renderer
+  * so decoding doesn't go through decode_vgmstream's switch for every frame.
+  */
+struct stream_renderer
+{
+    /// Render loop for the stream's layout, NULL if it's left to render_vgmstream.
+    layout_renderer render;
+    frame_decoder decoder;
+    /// Blocked layouts only, what render_vgmstream_blocked calls at the end of a block.
+    block_updater block_update;
+    /** Blocked layouts only, the blocks seen so far in stream order. Filled as
+      * they're played and walked by seek_planar, so going back to one is a direct jump.
+      */
+    std::vector<block_index_entry>* blocks;
+    /// Layouts made of child streams only (AIX, AAX and SCD interleave), a renderer for each of them.
+    child_streams* children;
+    /// get_vgmstream_frame_size, refreshed after each block since it may change with it.
+    int frame_size;
+    /// Interleaved layouts only, samples in a block and in the short last block.
+    int block_samples;
+    int shortblock_samples;
+};
+
+/** Picks the render loop and decoder for vgmstream, call again if its coding or layout changes.
+  * Must be paired with close_stream_renderer, some decoders start worker threads.
+  */
+void init_stream_renderer(VGMSTREAM* vgmstream, stream_renderer* renderer);
+
+/// Releases what init_stream_renderer set up, before vgmstream is closed.
+void close_stream_renderer(stream_renderer* renderer);
+
+/** render_vgmstream with one output buffer per channel.
+  * Streams whose layout and coding the player decodes itself (see decoders.hpp)
+  * go straight into channels, anything else is rendered by libvgmstream into
+  * scratch and split up afterwards, so scratch must hold sample_count * channels samples.
+  * Output and stream state afterwards are the same as render_vgmstream's.
+  */
+void render_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, sample** channels, int32_t sample_count, sample* scratch);
+
+/** The stream that counts the samples played of vgmstream. render_vgmstream_scd_int
+  * leaves that to the substreams, which all move together, the parent stays at 0.
+  */
+const VGMSTREAM* get_position_stream(const VGMSTREAM* vgmstream);
+
+/** Moves vgmstream to target_sample, looped streams wrap around within the loop
+  * and other streams stop at their last sample.
+  * Blocked layouts jump to the block through the index, with the channels as they
+  * were at the start of the stream apart from what the block header sets. The rest
+  * start over from the beginning when going back. The samples in between are decoded and dropped.
+  */
+void seek_planar(VGMSTREAM* vgmstream, stream_renderer* renderer, int32_t target_sample);
+
+#endif
@@ -0,0 +1,290 @@
+#include "render_pool.hpp"
+
+#include <cstddef>
+#include <vector>
+
+#ifdef _3DS
+extern "C"
+{
+    #include <3ds.h>
+}
+#else
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#endif
+
+#define RENDER_POOL_STACK_SIZE (16 * 1024)
+
+#ifdef _3DS
+struct render_pool_worker
+{
+    render_pool* pool;
+    Thread thread;
+    /// Signaled when there are jobs or the worker has to stop.
+    LightEvent start;
+};
+
+struct render_pool
+{
+    std::vector<render_pool_worker> workers;
+    LightLock lock;
+    /// Signaled once the last job of a render_pool_run call is done.
+    LightEvent finished;
+
+    /// Everything below is guarded by lock.
+    bool stop;
+    render_job job;
+    void* arg;
+    int job_count;
+    /// Jobs handed out and done so far.
+    int next;
+    int done;
+};
+
+/// Takes jobs until there are none left, job and arg are read with each one since a late worker may join the next call.
+static void run_jobs(render_pool* pool)
+{
+    LightLock_Lock(&pool->lock);
+    while (pool->next < pool->job_count)
+    {
+        int index = pool->next++;
+        render_job job = pool->job;
+        void* arg = pool->arg;
+        LightLock_Unlock(&pool->lock);
+        job(arg, index);
+        LightLock_Lock(&pool->lock);
+
+        if (++pool->done == pool->job_count)
+            LightEvent_Signal(&pool->finished);
+    }
+    LightLock_Unlock(&pool->lock);
+}
+
+static void worker_main(void* arg)
+{
+    render_pool_worker* worker = static_cast<render_pool_worker*>(arg);
+    render_pool* pool = worker->pool;
+
+    while (true)
+    {
+        LightEvent_Wait(&worker->start);
+        LightLock_Lock(&pool->lock);
+        bool stop = pool->stop;
+        LightLock_Unlock(&pool->lock);
+        if (stop)
+            break;
+        run_jobs(pool);
+    }
+}
+
+render_pool* render_pool_open(int workers)
+{
+    if (workers <= 0)
+        return NULL;
+
+    render_pool* pool = new render_pool();
+    LightLock_Init(&pool->lock);
+    LightEvent_Init(&pool->finished, RESET_ONESHOT);
+    pool->stop = false;
+    pool->job = NULL;
+    pool->arg = NULL;
+    pool->job_count = 0;
+    pool->next = 0;
+    pool->done = 0;
+    // workers keep a pointer to their slot, it can't move once they're started
+    pool->workers.resize(workers);
+
+    // the 3DS doesn't time slice threads of equal priority, so only other cores help, same as the prefetchers
+    s32 prio = 0;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    static const int cores[] = {2, 1};
+    int started = 0;
+    for (int core : cores)
+    {
+        if (started == workers)
+            break;
+        render_pool_worker& worker = pool->workers[started];
+        worker.pool = pool;
+        LightEvent_Init(&worker.start, RESET_ONESHOT);
+        worker.thread = threadCreate(worker_main, &worker, RENDER_POOL_STACK_SIZE, prio, core, false);
+        if (worker.thread)
+            started++;
+    }
+    pool->workers.resize(started);
+    if (started == 0)
+    {
+        delete pool;
+        return NULL;
+    }
+    return pool;
+}
+
+void render_pool_close(render_pool* pool)
+{
+    if (!pool)
+        return;
+
+    LightLock_Lock(&pool->lock);
+    pool->stop = true;
+    LightLock_Unlock(&pool->lock);
+    for (auto& worker : pool->workers)
+    {
+        LightEvent_Signal(&worker.start);
+        threadJoin(worker.thread, U64_MAX);
+        threadFree(worker.thread);
+    }
+    delete pool;
+}
+
+void render_pool_run(render_pool* pool, render_job job, void* arg, int job_count)
+{
+    if (!pool || job_count <= 1)
+    {
+        for (int i = 0; i < job_count; i++)
+            job(arg, i);
+        return;
+    }
+
+    LightLock_Lock(&pool->lock);
+    pool->job = job;
+    pool->arg = arg;
+    pool->job_count = job_count;
+    pool->next = 0;
+    pool->done = 0;
+    LightLock_Unlock(&pool->lock);
+    for (auto& worker : pool->workers)
+        LightEvent_Signal(&worker.start);
+
+    run_jobs(pool);
+    LightEvent_Wait(&pool->finished);
+}
+
+#else
+// host builds get the same pool on std::thread, capped at the two workers the 3DS can start
+#define RENDER_POOL_MAX_WORKERS 2
+
+struct render_pool
+{
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    /// Notified when there are jobs or the workers have to stop.
+    std::condition_variable start;
+    /// Notified once the last job of a render_pool_run call is done.
+    std::condition_variable finished;
+
+    /// Everything below is guarded by lock.
+    bool stop;
+    /// Bumped by each render_pool_run call that hands out jobs.
+    unsigned int generation;
+    render_job job;
+    void* arg;
+    int job_count;
+    /// Jobs handed out and done so far.
+    int next;
+    int done;
+};
+
+/// Takes jobs until there are none left, job and arg are read with each one since a late worker may join the next call.
+static void run_jobs(render_pool* pool, std::unique_lock<std::mutex>& guard)
+{
+    while (pool->next < pool->job_count)
+    {
+        int index = pool->next++;
+        render_job job = pool->job;
+        void* arg = pool->arg;
+        guard.unlock();
+        job(arg, index);
+        guard.lock();
+
+        if (++pool->done == pool->job_count)
+            pool->finished.notify_all();
+    }
+}
+
+static void worker_main(render_pool* pool)
+{
+    std::unique_lock<std::mutex> guard{pool->lock};
+    unsigned int seen = pool->generation;
+    while (true)
+    {
+        pool->start.wait(guard, [&] { return pool->stop || pool->generation != seen; });
+        if (pool->stop)
+            break;
+        seen = pool->generation;
+        run_jobs(pool, guard);
+    }
+}
+
+render_pool* render_pool_open(int workers)
+{
+    if (workers <= 0)
+        return NULL;
+    if (workers > RENDER_POOL_MAX_WORKERS)
+        workers = RENDER_POOL_MAX_WORKERS;
+
+    render_pool* pool = new render_pool();
+    pool->stop = false;
+    pool->generation = 0;
+    pool->job = NULL;
+    pool->arg = NULL;
+    pool->job_count = 0;
+    pool->next = 0;
+    pool->done = 0;
+    for (int i = 0; i < workers; i++)
+    {
+        try
+        {
+            pool->workers.emplace_back(worker_main, pool);
+        }
+        catch (const std::system_error&)
+        {
+            break;
+        }
+    }
+    if (pool->workers.empty())
+    {
+        delete pool;
+        return NULL;
+    }
+    return pool;
+}
+
+void render_pool_close(render_pool* pool)
+{
+    if (!pool)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard{pool->lock};
+        pool->stop = true;
+    }
+    pool->start.notify_all();
+    for (auto& worker : pool->workers)
+        worker.join();
+    delete pool;
+}
+
+void render_pool_run(render_pool* pool, render_job job, void* arg, int job_count)
+{
+    if (!pool || job_count <= 1)
+    {
+        for (int i = 0; i < job_count; i++)
+            job(arg, i);
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard{pool->lock};
+    pool->job = job;
+    pool->arg = arg;
+    pool->job_count = job_count;
+    pool->next = 0;
+    pool->done = 0;
+    pool->generation++;
+    pool->start.notify_all();
+
+    run_jobs(pool, guard);
+    pool->finished.wait(guard, [&] { return pool->done == pool->job_count; });
+}
+#endif
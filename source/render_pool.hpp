@@ -0,0 +1,26 @@
+#ifndef RENDER_POOL_HPP
+#define RENDER_POOL_HPP
+
+/** Runs a handful of independent jobs side by side on worker threads, used
+  * for the child streams of AIX and SCD interleave streams which share
+  * nothing but the file they read from. The calling thread takes jobs too and
+  * render_pool_run only returns once all of them are done, so whatever the
+  * jobs write is the same as if they ran one after another.
+  */
+struct render_pool;
+
+/// Runs job index of a render_pool_run call.
+typedef void (*render_job)(void* arg, int index);
+
+/** Starts up to workers worker threads on the cores the decoding thread isn't on.
+  * Returns NULL if none could be started, jobs are then run in place.
+  */
+render_pool* render_pool_open(int workers);
+
+/// Stops the workers, NULL is ignored.
+void render_pool_close(render_pool* pool);
+
+/// Runs job for every index below job_count and waits for all of them, pool may be NULL.
+void render_pool_run(render_pool* pool, render_job job, void* arg, int job_count);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+
+/** Fixed size lock free queue for exactly one producer thread and one consumer thread.
+  * Holds up to size - 1 items, push and pop never block and return false instead.
+  */
+template <typename T, size_t size>
+class spsc_queue
+{
+public:
+    spsc_queue() : head(0), tail(0) {}
+
+    /// Producer side, false if the queue is full.
+    bool push(const T& item)
+    {
+        size_t current = tail.load(std::memory_order_relaxed);
+        size_t next = (current + 1) % size;
+        if (next == head.load(std::memory_order_acquire))
+            return false;
+        items[current] = item;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer side, false if the queue is empty.
+    bool pop(T& item)
+    {
+        size_t current = head.load(std::memory_order_relaxed);
+        if (current == tail.load(std::memory_order_acquire))
+            return false;
+        item = items[current];
+        head.store((current + 1) % size, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[size];
+    /// Next item to pop, only written by the consumer.
+    std::atomic<size_t> head;
+    /// Next free slot, only written by the producer.
+    std::atomic<size_t> tail;
+};
+
+#endif
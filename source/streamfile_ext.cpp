@@ -0,0 +1,970 @@
+#include "streamfile_ext.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef _3DS
+extern "C"
+{
+    #include <3ds.h>
+}
+#else
+#include <mutex>
+#include <new>
+#endif
+
+#ifdef STREAMFILE_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** Read buffer sequentially read buffered streamfiles get, vgmstream opens
+  * channels with a 1KB one. Can be overridden from BUILD_FLAGS.
+  */
+#ifndef STREAMFILE_SEQUENTIAL_WINDOW
+#define STREAMFILE_SEQUENTIAL_WINDOW 0x10000
+#endif
+/// Same for MPEG streams, libvgmstream feeds mpg123 0x500 bytes per call.
+#ifndef STREAMFILE_MPEG_WINDOW
+#define STREAMFILE_MPEG_WINDOW 0x40000
+#endif
+
+static void close_ext(STREAMFILE* streamfile)
+{
+    reinterpret_cast<ext_streamfile*>(streamfile)->ops->close(streamfile);
+}
+
+static void init_ext(ext_streamfile* ext, const ext_streamfile_ops* ops, streamfile_mode mode)
+{
+    ext->sf.close = close_ext;
+    ext->ops = ops;
+    ext->mode = mode;
+}
+
+bool is_ext_streamfile(STREAMFILE* streamfile)
+{
+    return streamfile && streamfile->close == close_ext;
+}
+
+const uint8_t* peek_streamfile(STREAMFILE* streamfile, off_t offset, size_t length)
+{
+    if (!is_ext_streamfile(streamfile))
+        return NULL;
+    ext_streamfile* ext = reinterpret_cast<ext_streamfile*>(streamfile);
+    if (!ext->ops->peek)
+        return NULL;
+    return ext->ops->peek(streamfile, offset, length);
+}
+
+void advise_streamfile(STREAMFILE* streamfile, streamfile_access access, off_t start, size_t window)
+{
+    if (!is_ext_streamfile(streamfile))
+        return;
+    ext_streamfile* ext = reinterpret_cast<ext_streamfile*>(streamfile);
+    if (ext->ops->advise)
+        ext->ops->advise(streamfile, access, start, window);
+}
+
+void hint_streamfile(STREAMFILE* streamfile, off_t offset, size_t length)
+{
+    if (!is_ext_streamfile(streamfile))
+        return;
+    ext_streamfile* ext = reinterpret_cast<ext_streamfile*>(streamfile);
+    if (ext->ops->hint)
+        ext->ops->hint(streamfile, offset, length);
+}
+
+/// How far ahead channels of vgmstream are read, 0 if they aren't read sequentially.
+static size_t get_read_window(VGMSTREAM* vgmstream, streamfile_access access)
+{
+    if (access != STREAMFILE_ACCESS_SEQUENTIAL)
+        return 0;
+
+    switch (vgmstream->coding_type)
+    {
+#ifdef VGM_USE_MPEG
+        case coding_fake_MPEG2_L2:
+        case coding_MPEG1_L1:
+        case coding_MPEG1_L2:
+        case coding_MPEG1_L3:
+        case coding_MPEG2_L1:
+        case coding_MPEG2_L2:
+        case coding_MPEG2_L3:
+        case coding_MPEG25_L1:
+        case coding_MPEG25_L2:
+        case coding_MPEG25_L3:
+            return STREAMFILE_MPEG_WINDOW;
+#endif
+        default:
+            return STREAMFILE_SEQUENTIAL_WINDOW;
+    }
+}
+
+void advise_vgmstream_streamfiles(VGMSTREAM* vgmstream)
+{
+    streamfile_access access;
+    switch (vgmstream->layout_type)
+    {
+        // sub streams spread over the file (or over several files)
+        case layout_aix:
+        case layout_aax:
+        case layout_scd_int:
+        case layout_mus_acm:
+            access = STREAMFILE_ACCESS_RANDOM;
+            break;
+        default:
+            access = STREAMFILE_ACCESS_SEQUENTIAL;
+            break;
+    }
+    const size_t window = get_read_window(vgmstream, access);
+
+    for (int i = 0; i < vgmstream->channels; i++)
+    {
+        STREAMFILE* streamfile = vgmstream->ch[i].streamfile;
+        // channels may share a streamfile
+        bool seen = false;
+        for (int j = 0; j < i && !seen; j++)
+            seen = vgmstream->ch[j].streamfile == streamfile;
+        if (!seen)
+            advise_streamfile(streamfile, access, vgmstream->ch[i].channel_start_offset, window);
+    }
+
+    // HCA reads its blocks through its own streamfile, the channels don't have one
+    if (vgmstream->coding_type == coding_CRI_HCA)
+    {
+        hca_codec_data* data = static_cast<hca_codec_data*>(vgmstream->codec_data);
+        advise_streamfile(data->streamfile, access, data->start + data->info.dataOffset, window);
+    }
+}
+
+#ifdef _3DS
+/// Where a buffered streamfile's spare buffer is at.
+enum read_ahead_state
+{
+    AHEAD_IDLE,
+    /// A hint is waiting for the read ahead thread.
+    AHEAD_QUEUED,
+    /// The read ahead thread is reading into it, only it may touch the buffer.
+    AHEAD_FILLING,
+    /// Holds validsize bytes from offset on.
+    AHEAD_READY,
+};
+
+/// Spare buffer of a buffered streamfile, filled ahead of time from hints.
+struct read_ahead_buffer
+{
+    read_ahead_state state;
+    /// Where the hint wants it filled from or where it was filled from.
+    off_t offset;
+    size_t validsize;
+    uint8_t* buffer;
+    size_t buffersize;
+    /// The read ahead thread's own handle on the file, opened on its first fill.
+    FILE* infile;
+    /// Signaled whenever a fill finishes.
+    LightEvent filled;
+};
+#endif
+
+/*
+ * Buffered stdio streamfile, reads the same way vgmstream's own stdio
+ * streamfile does but lets callers peek into the buffer.
+ */
+struct buffered_streamfile
+{
+    ext_streamfile ext;
+    /** Reads and peeks take turns, child streams of AIX and SCD interleave streams
+      * read one shared streamfile from several threads (see render_pool.hpp).
+      * On the 3DS also guards ahead.
+      */
+#ifdef _3DS
+    LightLock lock;
+    read_ahead_buffer ahead;
+#else
+    std::mutex lock;
+#endif
+    FILE* infile;
+    /// file offset of buffer[0]
+    off_t offset;
+    size_t validsize;
+    uint8_t* buffer;
+    size_t buffersize;
+    size_t filesize;
+    char name[PATH_LIMIT];
+};
+
+#ifdef _3DS
+/*
+ * Read ahead for buffered streamfiles. Hints queue the range on one worker
+ * thread that reads it into the streamfile's spare buffer, a read landing
+ * there then swaps the buffers instead of waiting on the sd card. The thread
+ * runs while any streamfile has a spare buffer.
+ */
+#define READ_AHEAD_STACK_SIZE (8 * 1024)
+
+// what LightLock_Init sets, so it's usable before anything runs
+static LightLock read_ahead_lock = 1;
+/// Everything below is guarded by read_ahead_lock.
+static Thread read_ahead_thread = NULL;
+/// Signaled when a streamfile is queued or the thread has to stop.
+static LightEvent read_ahead_work;
+static bool read_ahead_stop = false;
+/// Streamfiles with a spare buffer, the thread is stopped once they're all closed.
+static int read_ahead_users = 0;
+static std::vector<buffered_streamfile*> read_ahead_queue;
+
+/// Takes the next queued streamfile and marks it filling, NULL if there's none.
+static buffered_streamfile* take_read_ahead(void)
+{
+    while (!read_ahead_queue.empty())
+    {
+        buffered_streamfile* streamfile = read_ahead_queue.front();
+        read_ahead_queue.erase(read_ahead_queue.begin());
+        // marked while read_ahead_lock is held so close_buffered either sees it filling or not queued at all
+        LightLock_Lock(&streamfile->lock);
+        bool queued = streamfile->ahead.state == AHEAD_QUEUED;
+        if (queued)
+            streamfile->ahead.state = AHEAD_FILLING;
+        LightLock_Unlock(&streamfile->lock);
+        if (queued)
+            return streamfile;
+    }
+    return NULL;
+}
+
+static void read_ahead_main(void* arg)
+{
+    LightLock_Lock(&read_ahead_lock);
+    while (!read_ahead_stop)
+    {
+        buffered_streamfile* streamfile = take_read_ahead();
+        if (!streamfile)
+        {
+            LightLock_Unlock(&read_ahead_lock);
+            LightEvent_Wait(&read_ahead_work);
+            LightLock_Lock(&read_ahead_lock);
+            continue;
+        }
+        LightLock_Unlock(&read_ahead_lock);
+
+        read_ahead_buffer& ahead = streamfile->ahead;
+        if (!ahead.infile)
+            ahead.infile = fopen(streamfile->name, "rb");
+        size_t validsize = 0;
+        if (ahead.infile && !fseeko(ahead.infile, ahead.offset, SEEK_SET))
+            validsize = fread(ahead.buffer, 1, ahead.buffersize, ahead.infile);
+
+        LightLock_Lock(&streamfile->lock);
+        ahead.validsize = validsize;
+        ahead.state = validsize ? AHEAD_READY : AHEAD_IDLE;
+        LightEvent_Signal(&ahead.filled);
+        LightLock_Unlock(&streamfile->lock);
+
+        LightLock_Lock(&read_ahead_lock);
+    }
+    LightLock_Unlock(&read_ahead_lock);
+}
+
+/// Gives streamfile a spare buffer, starting the thread if it's the first. Returns false if either can't be had.
+static bool start_read_ahead(buffered_streamfile* streamfile)
+{
+    read_ahead_buffer& ahead = streamfile->ahead;
+    ahead.buffer = static_cast<uint8_t*>(malloc(streamfile->buffersize));
+    if (!ahead.buffer)
+        return false;
+    ahead.buffersize = streamfile->buffersize;
+
+    LightLock_Lock(&read_ahead_lock);
+    // one that's still stopping can't be restarted, the streamfile goes without
+    if (!read_ahead_thread && !read_ahead_stop)
+    {
+        LightEvent_Init(&read_ahead_work, RESET_ONESHOT);
+        // the sd card is read through the fs service, so even sharing the decoding thread's core it gets to wait there
+        s32 prio = 0;
+        svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+        read_ahead_thread = threadCreate(read_ahead_main, NULL, READ_AHEAD_STACK_SIZE, prio, 2, false);
+        if (!read_ahead_thread)
+            read_ahead_thread = threadCreate(read_ahead_main, NULL, READ_AHEAD_STACK_SIZE, prio, 1, false);
+    }
+    bool started = read_ahead_thread != NULL && !read_ahead_stop;
+    if (started)
+        read_ahead_users++;
+    LightLock_Unlock(&read_ahead_lock);
+
+    if (!started)
+    {
+        free(ahead.buffer);
+        ahead.buffer = NULL;
+    }
+    return started;
+}
+
+/// Takes streamfile out of the read ahead, stopping the thread if it was the last one. lock must not be held.
+static void stop_read_ahead(buffered_streamfile* streamfile)
+{
+    read_ahead_buffer& ahead = streamfile->ahead;
+    if (!ahead.buffer)
+        return;
+
+    Thread thread = NULL;
+    LightLock_Lock(&read_ahead_lock);
+    read_ahead_queue.erase(std::remove(read_ahead_queue.begin(), read_ahead_queue.end(), streamfile), read_ahead_queue.end());
+    if (--read_ahead_users == 0)
+    {
+        thread = read_ahead_thread;
+        read_ahead_stop = true;
+        LightEvent_Signal(&read_ahead_work);
+    }
+    LightLock_Unlock(&read_ahead_lock);
+
+    LightLock_Lock(&streamfile->lock);
+    while (ahead.state == AHEAD_FILLING)
+    {
+        LightLock_Unlock(&streamfile->lock);
+        LightEvent_Wait(&ahead.filled);
+        LightLock_Lock(&streamfile->lock);
+    }
+    LightLock_Unlock(&streamfile->lock);
+
+    if (thread)
+    {
+        threadJoin(thread, U64_MAX);
+        threadFree(thread);
+        LightLock_Lock(&read_ahead_lock);
+        read_ahead_thread = NULL;
+        read_ahead_stop = false;
+        LightLock_Unlock(&read_ahead_lock);
+    }
+    if (ahead.infile)
+        fclose(ahead.infile);
+    free(ahead.buffer);
+    ahead.buffer = NULL;
+}
+
+/// Swaps in the spare buffer if it holds offset, waiting for it if it's being filled for it. lock is held.
+static bool use_read_ahead(buffered_streamfile* streamfile, off_t offset)
+{
+    read_ahead_buffer& ahead = streamfile->ahead;
+    if (ahead.state == AHEAD_QUEUED)
+    {
+        // the read can't wait for the queue, the thread skips it once it's no longer queued
+        ahead.state = AHEAD_IDLE;
+        return false;
+    }
+    while (ahead.state == AHEAD_FILLING && offset >= ahead.offset && offset < static_cast<off_t>(ahead.offset + ahead.buffersize))
+    {
+        LightLock_Unlock(&streamfile->lock);
+        LightEvent_Wait(&ahead.filled);
+        LightLock_Lock(&streamfile->lock);
+    }
+    if (ahead.state != AHEAD_READY || offset < ahead.offset || offset >= static_cast<off_t>(ahead.offset + ahead.validsize))
+        return false;
+
+    std::swap(streamfile->buffer, ahead.buffer);
+    std::swap(streamfile->buffersize, ahead.buffersize);
+    streamfile->offset = ahead.offset;
+    streamfile->validsize = ahead.validsize;
+    ahead.state = AHEAD_IDLE;
+    return true;
+}
+#endif
+
+/// Fills the buffer so it holds offset, the buffer may start before it if read ahead had it.
+static bool fill_buffered(buffered_streamfile* streamfile, off_t offset)
+{
+#ifdef _3DS
+    if (use_read_ahead(streamfile, offset))
+        return true;
+#endif
+    streamfile->validsize = 0;
+    if (fseeko(streamfile->infile, offset, SEEK_SET))
+        return false;
+    streamfile->offset = offset;
+    streamfile->validsize = fread(streamfile->buffer, 1, streamfile->buffersize, streamfile->infile);
+    return true;
+}
+
+static size_t read_buffered_unlocked(buffered_streamfile* streamfile, uint8_t* dest, off_t offset, size_t length)
+{
+    if (!dest || length == 0 || offset < 0)
+        return 0;
+
+    size_t length_read_total = 0;
+    while (length > 0)
+    {
+        // is the beginning at least there?
+        if (offset < streamfile->offset || offset >= static_cast<off_t>(streamfile->offset + streamfile->validsize))
+        {
+            // nothing read means end of file
+            if (!fill_buffered(streamfile, offset) || offset >= static_cast<off_t>(streamfile->offset + streamfile->validsize))
+                break;
+        }
+
+        size_t offset_into_buffer = offset - streamfile->offset;
+        size_t length_read = std::min(length, streamfile->validsize - offset_into_buffer);
+        memcpy(dest, streamfile->buffer + offset_into_buffer, length_read);
+        length_read_total += length_read;
+        length -= length_read;
+        offset += length_read;
+        dest += length_read;
+    }
+
+    return length_read_total;
+}
+
+/// Holds a buffered streamfile's lock for a read or peek.
+#ifdef _3DS
+struct buffered_guard
+{
+    explicit buffered_guard(buffered_streamfile* streamfile) : lock(&streamfile->lock) { LightLock_Lock(lock); }
+    ~buffered_guard() { LightLock_Unlock(lock); }
+    LightLock* lock;
+};
+#else
+struct buffered_guard
+{
+    explicit buffered_guard(buffered_streamfile* streamfile) : guard(streamfile->lock) {}
+    std::lock_guard<std::mutex> guard;
+};
+#endif
+
+static size_t read_buffered(STREAMFILE* sf, uint8_t* dest, off_t offset, size_t length)
+{
+    buffered_streamfile* streamfile = reinterpret_cast<buffered_streamfile*>(sf);
+    buffered_guard guard(streamfile);
+    return read_buffered_unlocked(streamfile, dest, offset, length);
+}
+
+static bool has_buffered(buffered_streamfile* streamfile, off_t offset, size_t length)
+{
+    return offset >= streamfile->offset && static_cast<off_t>(offset + length) <= static_cast<off_t>(streamfile->offset + streamfile->validsize);
+}
+
+static const uint8_t* peek_buffered_unlocked(buffered_streamfile* streamfile, off_t offset, size_t length)
+{
+    if (offset < 0 || length > streamfile->buffersize)
+        return NULL;
+
+    if (!has_buffered(streamfile, offset, length))
+    {
+        if (!fill_buffered(streamfile, offset) || !has_buffered(streamfile, offset, length))
+            return NULL;
+    }
+
+    return streamfile->buffer + (offset - streamfile->offset);
+}
+
+static const uint8_t* peek_buffered(STREAMFILE* sf, off_t offset, size_t length)
+{
+    buffered_streamfile* streamfile = reinterpret_cast<buffered_streamfile*>(sf);
+    buffered_guard guard(streamfile);
+    return peek_buffered_unlocked(streamfile, offset, length);
+}
+
+/// Has the read ahead thread fill the spare buffer from offset on unless the buffers already hold it.
+static void hint_buffered(STREAMFILE* sf, off_t offset, size_t length)
+{
+#ifdef _3DS
+    buffered_streamfile* streamfile = reinterpret_cast<buffered_streamfile*>(sf);
+    if (offset < 0 || static_cast<size_t>(offset) >= streamfile->filesize)
+        return;
+    length = std::min(length, streamfile->buffersize);
+
+    LightLock_Lock(&streamfile->lock);
+    read_ahead_buffer& ahead = streamfile->ahead;
+    bool queue = !has_buffered(streamfile, offset, length) && ahead.state != AHEAD_FILLING
+        && !(ahead.state != AHEAD_IDLE && offset >= ahead.offset && static_cast<off_t>(offset + length) <= static_cast<off_t>(ahead.offset + ahead.buffersize));
+    LightLock_Unlock(&streamfile->lock);
+    if (!queue || (!streamfile->ahead.buffer && !start_read_ahead(streamfile)))
+        return;
+
+    LightLock_Lock(&streamfile->lock);
+    // the last hint wins, a queued streamfile keeps its place in the queue
+    queue = ahead.state == AHEAD_IDLE || ahead.state == AHEAD_READY;
+    if (ahead.state != AHEAD_FILLING)
+    {
+        ahead.offset = offset;
+        ahead.state = AHEAD_QUEUED;
+    }
+    LightLock_Unlock(&streamfile->lock);
+    if (!queue)
+        return;
+
+    LightLock_Lock(&read_ahead_lock);
+    read_ahead_queue.push_back(streamfile);
+    LightLock_Unlock(&read_ahead_lock);
+    LightEvent_Signal(&read_ahead_work);
+#endif
+}
+
+static size_t get_size_buffered(STREAMFILE* sf)
+{
+    return reinterpret_cast<buffered_streamfile*>(sf)->filesize;
+}
+
+static off_t get_offset_buffered(STREAMFILE* sf)
+{
+    return reinterpret_cast<buffered_streamfile*>(sf)->offset;
+}
+
+static void get_name_buffered(STREAMFILE* sf, char* buffer, size_t length)
+{
+    strncpy(buffer, reinterpret_cast<buffered_streamfile*>(sf)->name, length);
+    buffer[length - 1] = '\0';
+}
+
+static STREAMFILE* open_buffered(STREAMFILE* sf, const char* const filename, size_t buffersize)
+{
+    if (!filename)
+        return NULL;
+
+    return open_ext_streamfile(filename, STREAMFILE_MODE_BUFFERED, buffersize);
+}
+
+/// Sequential reads get a bigger buffer so the sd card sees fewer, larger reads.
+static void advise_buffered(STREAMFILE* sf, streamfile_access access, off_t start, size_t window)
+{
+    buffered_streamfile* streamfile = reinterpret_cast<buffered_streamfile*>(sf);
+    if (access != STREAMFILE_ACCESS_SEQUENTIAL)
+        return;
+    if (window == 0)
+        window = STREAMFILE_SEQUENTIAL_WINDOW;
+    window = std::min(window, streamfile->filesize);
+    if (window <= streamfile->buffersize)
+        return;
+
+    // what's in the buffer stays valid, it only gets room to grow on the next fill
+    uint8_t* buffer = static_cast<uint8_t*>(realloc(streamfile->buffer, window));
+    if (!buffer)
+        return;
+    streamfile->buffer = buffer;
+    streamfile->buffersize = window;
+}
+
+static void close_buffered(STREAMFILE* sf)
+{
+    buffered_streamfile* streamfile = reinterpret_cast<buffered_streamfile*>(sf);
+#ifdef _3DS
+    stop_read_ahead(streamfile);
+#else
+    streamfile->lock.~mutex();
+#endif
+    fclose(streamfile->infile);
+    free(streamfile->buffer);
+    free(streamfile);
+}
+
+static const ext_streamfile_ops buffered_ops =
+{
+    peek_buffered,
+    advise_buffered,
+    hint_buffered,
+    close_buffered,
+};
+
+static STREAMFILE* open_buffered_streamfile(FILE* infile, const char* filename, size_t buffersize)
+{
+    buffered_streamfile* streamfile = static_cast<buffered_streamfile*>(calloc(1, sizeof(buffered_streamfile)));
+    if (!streamfile)
+        return NULL;
+
+    streamfile->buffer = static_cast<uint8_t*>(calloc(buffersize, 1));
+    if (!streamfile->buffer)
+    {
+        free(streamfile);
+        return NULL;
+    }
+
+    init_ext(&streamfile->ext, &buffered_ops, STREAMFILE_MODE_BUFFERED);
+#ifdef _3DS
+    LightLock_Init(&streamfile->lock);
+    LightEvent_Init(&streamfile->ahead.filled, RESET_ONESHOT);
+#else
+    // calloc'd, the mutex still has to be constructed
+    new (&streamfile->lock) std::mutex;
+#endif
+    STREAMFILE* sf = &streamfile->ext.sf;
+    sf->read = read_buffered;
+    sf->get_size = get_size_buffered;
+    sf->get_offset = get_offset_buffered;
+    sf->get_name = get_name_buffered;
+    sf->get_realname = get_name_buffered;
+    sf->open = open_buffered;
+
+    streamfile->infile = infile;
+    streamfile->buffersize = buffersize;
+    strncpy(streamfile->name, filename, sizeof(streamfile->name));
+    streamfile->name[sizeof(streamfile->name) - 1] = '\0';
+
+    fseeko(infile, 0, SEEK_END);
+    streamfile->filesize = ftello(infile);
+
+    return sf;
+}
+
+/*
+ * Memory streamfile, the file is read in once and every STREAMFILE opened on
+ * the same name through it shares the data.
+ */
+struct memory_blob
+{
+    uint8_t* data;
+    size_t size;
+    int refs;
+    /// Companion files up to this size are loaded too, bigger ones are buffered. Negative if there's no limit.
+    off_t memory_limit;
+};
+
+struct memory_streamfile
+{
+    ext_streamfile ext;
+    memory_blob* blob;
+    char name[PATH_LIMIT];
+};
+
+static STREAMFILE* open_memory_streamfile(memory_blob* blob, const char* filename);
+static STREAMFILE* open_ext(const char* filename, streamfile_mode mode, size_t buffersize, off_t memory_limit);
+
+static size_t read_memory(STREAMFILE* sf, uint8_t* dest, off_t offset, size_t length)
+{
+    memory_blob* blob = reinterpret_cast<memory_streamfile*>(sf)->blob;
+    if (!dest || offset < 0 || static_cast<size_t>(offset) >= blob->size)
+        return 0;
+
+    length = std::min(length, static_cast<size_t>(blob->size - offset));
+    memcpy(dest, blob->data + offset, length);
+    return length;
+}
+
+static const uint8_t* peek_memory(STREAMFILE* sf, off_t offset, size_t length)
+{
+    memory_blob* blob = reinterpret_cast<memory_streamfile*>(sf)->blob;
+    if (offset < 0 || static_cast<size_t>(offset) + length > blob->size)
+        return NULL;
+    return blob->data + offset;
+}
+
+static size_t get_size_memory(STREAMFILE* sf)
+{
+    return reinterpret_cast<memory_streamfile*>(sf)->blob->size;
+}
+
+static off_t get_offset_memory(STREAMFILE* sf)
+{
+    return 0;
+}
+
+static void get_name_memory(STREAMFILE* sf, char* buffer, size_t length)
+{
+    strncpy(buffer, reinterpret_cast<memory_streamfile*>(sf)->name, length);
+    buffer[length - 1] = '\0';
+}
+
+static STREAMFILE* open_memory(STREAMFILE* sf, const char* const filename, size_t buffersize)
+{
+    memory_streamfile* streamfile = reinterpret_cast<memory_streamfile*>(sf);
+    if (!filename)
+        return NULL;
+
+    if (!strcmp(streamfile->name, filename))
+    {
+        STREAMFILE* newstreamfile = open_memory_streamfile(streamfile->blob, filename);
+        if (newstreamfile)
+            streamfile->blob->refs++;
+        return newstreamfile;
+    }
+
+    // a small header may name a huge data file, it gets loaded only within the limit the header was opened with
+    return open_ext(filename, STREAMFILE_MODE_MEMORY, buffersize, streamfile->blob->memory_limit);
+}
+
+static void close_memory(STREAMFILE* sf)
+{
+    memory_streamfile* streamfile = reinterpret_cast<memory_streamfile*>(sf);
+    if (--streamfile->blob->refs == 0)
+    {
+        free(streamfile->blob->data);
+        free(streamfile->blob);
+    }
+    free(streamfile);
+}
+
+static const ext_streamfile_ops memory_ops =
+{
+    peek_memory,
+    NULL,
+    NULL,
+    close_memory,
+};
+
+static STREAMFILE* open_memory_streamfile(memory_blob* blob, const char* filename)
+{
+    memory_streamfile* streamfile = static_cast<memory_streamfile*>(calloc(1, sizeof(memory_streamfile)));
+    if (!streamfile)
+        return NULL;
+
+    init_ext(&streamfile->ext, &memory_ops, STREAMFILE_MODE_MEMORY);
+    STREAMFILE* sf = &streamfile->ext.sf;
+    sf->read = read_memory;
+    sf->get_size = get_size_memory;
+    sf->get_offset = get_offset_memory;
+    sf->get_name = get_name_memory;
+    sf->get_realname = get_name_memory;
+    sf->open = open_memory;
+
+    streamfile->blob = blob;
+    strncpy(streamfile->name, filename, sizeof(streamfile->name));
+    streamfile->name[sizeof(streamfile->name) - 1] = '\0';
+
+    return sf;
+}
+
+static memory_blob* load_memory_blob(FILE* infile)
+{
+    memory_blob* blob = static_cast<memory_blob*>(calloc(1, sizeof(memory_blob)));
+    if (!blob)
+        return NULL;
+
+    fseeko(infile, 0, SEEK_END);
+    blob->size = ftello(infile);
+    fseeko(infile, 0, SEEK_SET);
+    // malloc(0) may hand back NULL, keep empty files openable
+    blob->data = static_cast<uint8_t*>(malloc(blob->size ? blob->size : 1));
+    if (!blob->data || fread(blob->data, 1, blob->size, infile) != blob->size)
+    {
+        free(blob->data);
+        free(blob);
+        return NULL;
+    }
+
+    blob->refs = 1;
+    return blob;
+}
+
+#ifdef STREAMFILE_HAVE_MMAP
+/*
+ * mmap streamfile for host builds, the kernel does the buffering and read
+ * ahead so decoding is bound by the codecs rather than syscalls.
+ */
+struct mmap_streamfile
+{
+    ext_streamfile ext;
+    uint8_t* data;
+    size_t size;
+    char name[PATH_LIMIT];
+};
+
+/// Bytes asked to be faulted in ahead of the first read.
+#define MMAP_WILLNEED_SIZE 0x100000
+
+static size_t read_mmap(STREAMFILE* sf, uint8_t* dest, off_t offset, size_t length)
+{
+    mmap_streamfile* streamfile = reinterpret_cast<mmap_streamfile*>(sf);
+    if (!dest || offset < 0 || static_cast<size_t>(offset) >= streamfile->size)
+        return 0;
+
+    length = std::min(length, static_cast<size_t>(streamfile->size - offset));
+    memcpy(dest, streamfile->data + offset, length);
+    return length;
+}
+
+static const uint8_t* peek_mmap(STREAMFILE* sf, off_t offset, size_t length)
+{
+    mmap_streamfile* streamfile = reinterpret_cast<mmap_streamfile*>(sf);
+    if (offset < 0 || static_cast<size_t>(offset) + length > streamfile->size)
+        return NULL;
+    return streamfile->data + offset;
+}
+
+static void advise_mmap(STREAMFILE* sf, streamfile_access access, off_t start, size_t window)
+{
+    mmap_streamfile* streamfile = reinterpret_cast<mmap_streamfile*>(sf);
+    if (streamfile->size == 0)
+        return;
+
+    int advice = MADV_NORMAL;
+    if (access == STREAMFILE_ACCESS_SEQUENTIAL)
+        advice = MADV_SEQUENTIAL;
+    else if (access == STREAMFILE_ACCESS_RANDOM)
+        advice = MADV_RANDOM;
+    madvise(streamfile->data, streamfile->size, advice);
+
+    if (access != STREAMFILE_ACCESS_SEQUENTIAL || start < 0 || static_cast<size_t>(start) >= streamfile->size)
+        return;
+
+    // madvise wants a page aligned address
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t aligned = start / page * page;
+    size_t length = std::min(window ? window : static_cast<size_t>(MMAP_WILLNEED_SIZE), streamfile->size - aligned);
+    madvise(streamfile->data + aligned, length, MADV_WILLNEED);
+}
+
+/// The kernel's read ahead does the rest.
+static void hint_mmap(STREAMFILE* sf, off_t offset, size_t length)
+{
+    mmap_streamfile* streamfile = reinterpret_cast<mmap_streamfile*>(sf);
+    if (offset < 0 || static_cast<size_t>(offset) >= streamfile->size)
+        return;
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t aligned = offset / page * page;
+    madvise(streamfile->data + aligned, std::min(offset - aligned + length, streamfile->size - aligned), MADV_WILLNEED);
+}
+
+static size_t get_size_mmap(STREAMFILE* sf)
+{
+    return reinterpret_cast<mmap_streamfile*>(sf)->size;
+}
+
+static off_t get_offset_mmap(STREAMFILE* sf)
+{
+    return 0;
+}
+
+static void get_name_mmap(STREAMFILE* sf, char* buffer, size_t length)
+{
+    strncpy(buffer, reinterpret_cast<mmap_streamfile*>(sf)->name, length);
+    buffer[length - 1] = '\0';
+}
+
+static STREAMFILE* open_mmap(STREAMFILE* sf, const char* const filename, size_t buffersize)
+{
+    return open_ext_streamfile(filename, STREAMFILE_MODE_MMAP, buffersize);
+}
+
+static void close_mmap(STREAMFILE* sf)
+{
+    mmap_streamfile* streamfile = reinterpret_cast<mmap_streamfile*>(sf);
+    if (streamfile->size)
+        munmap(streamfile->data, streamfile->size);
+    free(streamfile);
+}
+
+static const ext_streamfile_ops mmap_ops =
+{
+    peek_mmap,
+    advise_mmap,
+    hint_mmap,
+    close_mmap,
+};
+
+static STREAMFILE* open_mmap_streamfile(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    mmap_streamfile* streamfile = static_cast<mmap_streamfile*>(calloc(1, sizeof(mmap_streamfile)));
+    if (!streamfile)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    streamfile->size = st.st_size;
+    // zero length mappings are invalid, an empty file just never returns data
+    if (streamfile->size)
+    {
+        void* data = mmap(NULL, streamfile->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            free(streamfile);
+            return NULL;
+        }
+        streamfile->data = static_cast<uint8_t*>(data);
+    }
+    // the mapping keeps the file alive
+    close(fd);
+
+    init_ext(&streamfile->ext, &mmap_ops, STREAMFILE_MODE_MMAP);
+    STREAMFILE* sf = &streamfile->ext.sf;
+    sf->read = read_mmap;
+    sf->get_size = get_size_mmap;
+    sf->get_offset = get_offset_mmap;
+    sf->get_name = get_name_mmap;
+    sf->get_realname = get_name_mmap;
+    sf->open = open_mmap;
+
+    strncpy(streamfile->name, filename, sizeof(streamfile->name));
+    streamfile->name[sizeof(streamfile->name) - 1] = '\0';
+
+    return sf;
+}
+#endif
+
+/// open_ext_streamfile, files over memory_limit bytes are opened buffered instead of in memory unless it's negative.
+static STREAMFILE* open_ext(const char* filename, streamfile_mode mode, size_t buffersize, off_t memory_limit)
+{
+    if (!filename)
+        return NULL;
+
+#ifdef STREAMFILE_HAVE_MMAP
+    if (mode == STREAMFILE_MODE_MMAP)
+        return open_mmap_streamfile(filename);
+#endif
+
+    FILE* infile = fopen(filename, "rb");
+    if (!infile)
+        return NULL;
+
+    if (mode == STREAMFILE_MODE_MEMORY && memory_limit >= 0)
+    {
+        fseeko(infile, 0, SEEK_END);
+        if (ftello(infile) > memory_limit)
+            mode = STREAMFILE_MODE_BUFFERED;
+        fseeko(infile, 0, SEEK_SET);
+    }
+
+    STREAMFILE* streamfile = NULL;
+    switch (mode)
+    {
+        case STREAMFILE_MODE_BUFFERED:
+            streamfile = open_buffered_streamfile(infile, filename, buffersize);
+            if (!streamfile)
+                fclose(infile);
+            break;
+        case STREAMFILE_MODE_MEMORY:
+        {
+            memory_blob* blob = load_memory_blob(infile);
+            fclose(infile);
+            if (!blob)
+                break;
+            blob->memory_limit = memory_limit;
+            streamfile = open_memory_streamfile(blob, filename);
+            if (!streamfile)
+            {
+                free(blob->data);
+                free(blob);
+            }
+            break;
+        }
+        default:
+            fclose(infile);
+            break;
+    }
+
+    return streamfile;
+}
+
+STREAMFILE* open_ext_streamfile(const char* filename, streamfile_mode mode, size_t buffersize)
+{
+    return open_ext(filename, mode, buffersize, -1);
+}
+
+STREAMFILE* open_ext_streamfile_limited(const char* filename, off_t memory_limit, size_t buffersize)
+{
+    return open_ext(filename, STREAMFILE_MODE_MEMORY, buffersize, memory_limit);
+}
@@ -0,0 +1,92 @@
+#ifndef STREAMFILE_EXT_HPP
+#define STREAMFILE_EXT_HPP
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+/// Host builds (batch tools, benchmarks) can map files instead of reading them.
+#if !defined(_3DS) && defined(__unix__)
+#define STREAMFILE_HAVE_MMAP
+#endif
+
+/// How an ext streamfile gets its bytes.
+enum streamfile_mode
+{
+    /// stdio with a private read buffer, same behaviour as vgmstream's stdio streamfile.
+    STREAMFILE_MODE_BUFFERED,
+    /// Whole file loaded once and shared by every STREAMFILE opened on it.
+    STREAMFILE_MODE_MEMORY,
+#ifdef STREAMFILE_HAVE_MMAP
+    /// File mapped read only, reads are a bounds checked memcpy.
+    STREAMFILE_MODE_MMAP,
+#endif
+};
+
+/// Expected access pattern, used to tune read ahead.
+enum streamfile_access
+{
+    STREAMFILE_ACCESS_NORMAL,
+    /// Reads walk forward through the file.
+    STREAMFILE_ACCESS_SEQUENTIAL,
+    /// Reads jump around (multiple sub streams in one file).
+    STREAMFILE_ACCESS_RANDOM,
+};
+
+/// Player side entry points that libvgmstream's STREAMFILE vtable has no room for.
+struct ext_streamfile_ops
+{
+    /// Returns a pointer to length bytes at offset or NULL if they can't be made resident.
+    const uint8_t* (*peek)(STREAMFILE* streamfile, off_t offset, size_t length);
+    /** Optional, tells the streamfile how it is going to be read from start onwards.
+      * window is how far ahead sequential reads are worth buffering, 0 for the streamfile's default.
+      */
+    void (*advise)(STREAMFILE* streamfile, streamfile_access access, off_t start, size_t window);
+    /// Optional, tells the streamfile length bytes from offset on are read next, before anything else is.
+    void (*hint)(STREAMFILE* streamfile, off_t offset, size_t length);
+    void (*close)(STREAMFILE* streamfile);
+};
+
+/// Common header of every STREAMFILE opened through open_ext_streamfile.
+/// sf must stay first so vgmstream can use these as plain STREAMFILEs.
+struct ext_streamfile
+{
+    STREAMFILE sf;
+    const ext_streamfile_ops* ops;
+    streamfile_mode mode;
+};
+
+/** Opens filename as a STREAMFILE, companion files opened by vgmstream through
+  * it (channels, dual file stereo) get the same mode.
+  * Returns NULL if the file couldn't be opened.
+  */
+STREAMFILE* open_ext_streamfile(const char* filename, streamfile_mode mode, size_t buffersize = STREAMFILE_DEFAULT_BUFFER_SIZE);
+
+/** Opens filename in memory mode if it's at most memory_limit bytes and buffered
+  * otherwise. Companion files opened through it are held to the same limit,
+  * so a small header can't pull a huge data file into memory.
+  */
+STREAMFILE* open_ext_streamfile_limited(const char* filename, off_t memory_limit, size_t buffersize = STREAMFILE_DEFAULT_BUFFER_SIZE);
+
+/// True if streamfile was created by open_ext_streamfile (or opened through one).
+bool is_ext_streamfile(STREAMFILE* streamfile);
+
+/** Zero copy access to a STREAMFILE's data.
+  * Returns a pointer valid until the next read/peek on streamfile, or NULL if
+  * the streamfile can't provide one in which case read_streamfile must be used.
+  */
+const uint8_t* peek_streamfile(STREAMFILE* streamfile, off_t offset, size_t length);
+
+/// Passes an access pattern down to streamfile, does nothing if it doesn't care.
+void advise_streamfile(STREAMFILE* streamfile, streamfile_access access, off_t start = 0, size_t window = 0);
+
+/** Lets streamfile start reading length bytes at offset before they're asked for,
+  * does nothing if it can't. Buffered streamfiles read them on a worker thread on the 3DS.
+  */
+void hint_streamfile(STREAMFILE* streamfile, off_t offset, size_t length);
+
+/// Advises every channel streamfile of vgmstream based on how its layout reads data.
+void advise_vgmstream_streamfiles(VGMSTREAM* vgmstream);
+
+#endif
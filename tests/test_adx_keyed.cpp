@@ -0,0 +1,248 @@
+/** init_vgmstream_adx_keyed stands in for init_vgmstream_adx when the probe
+  * cache already holds a file's key, so given the key find_key settled on it
+  * has to open exactly the VGMSTREAM the library does, filter coefficients
+  * included. Generated type 03, 04 and encrypted headers are checked against
+  * the reference meta, then randomly damaged copies of them.
+  */
+
+#include <cstring>
+
+#include "test_support.hpp"
+#include "vgmstream_reference.hpp"
+
+#include "adx_keyed.hpp"
+
+extern "C"
+{
+    #include <coding/coding.h>
+    #include <meta/meta.h>
+}
+
+static void put_16be(std::vector<uint8_t>& data, size_t offset, uint16_t value)
+{
+    data[offset] = value >> 8;
+    data[offset + 1] = value;
+}
+
+static void put_32be(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+{
+    put_16be(data, offset, value >> 16);
+    put_16be(data, offset + 2, value);
+}
+
+/// A key from each of the library's tables, keys_8[3] and keys_9[0].
+static const uint16_t key_8[3] = {0x4f3f, 0x472f, 0x562f};
+static const uint16_t key_9[3] = {0x07d2, 0x1ec5, 0x0c7f};
+
+/** An ADX file with header version version (0x0300, 0x0400, 0x0408 or 0x0409)
+  * and random stream parameters. Encrypted files get frame scales that match
+  * their table's key, the way find_key tests them.
+  */
+static std::vector<uint8_t> make_adx(uint16_t version, test_random& random)
+{
+    const int channels = 1 + random.below(random.below(4) ? 2 : 8);
+    const int32_t num_samples = 32 * (1 + random.below(300)) - random.below(32);
+    const bool ainf = version != 0x0300 && random.below(4) == 0;
+    const int32_t ainf_length = ainf ? random.below(0x60) : 0;
+    // sometimes too short for loop info
+    int32_t stream_offset = (version == 0x0300 ? 0x2C : 0x38) + 6 + ainf_length + random.below(0x80) - 0x10;
+    stream_offset = std::max(stream_offset, 0x20);
+
+    const int frames = (num_samples + 31) / 32 * channels;
+    std::vector<uint8_t> data(stream_offset + frames * 18);
+    put_16be(data, 0x00, 0x8000);
+    put_16be(data, 0x02, stream_offset - 4);
+    data[0x04] = 3;
+    data[0x05] = 18;
+    data[0x06] = 4;
+    data[0x07] = channels;
+    static const int32_t sample_rates[] = {48000, 44100, 32000, 22050, 11025, 8000};
+    put_32be(data, 0x08, random.below(2) ? sample_rates[random.below(6)] : 1 + random.below(200000));
+    put_32be(data, 0x0C, num_samples);
+    put_16be(data, 0x10, random.below(2) ? 500 : random.below(0x10000));
+    put_16be(data, 0x12, version);
+
+    const bool loop = random.below(3) != 0;
+    const uint32_t loop_start = loop ? random.below(num_samples) : 0;
+    const uint32_t loop_end = loop ? loop_start + random.below(num_samples - loop_start + 1) : 0;
+    if (version == 0x0300)
+    {
+        put_32be(data, 0x18, loop);
+        put_32be(data, 0x1C, loop_start);
+        put_32be(data, 0x24, loop_end);
+    }
+    else if (ainf)
+    {
+        put_32be(data, 0x24, 0x41494E46); // "AINF"
+        put_32be(data, 0x28, ainf_length);
+    }
+    else
+    {
+        static const uint32_t loop_types[] = {0, 1, 0xFFFEFFFE};
+        put_32be(data, 0x24, loop ? loop_types[random.below(3)] : 0);
+        put_32be(data, 0x28, loop_start);
+        put_32be(data, 0x30, loop_end);
+    }
+    put_16be(data, stream_offset - 6, 0x2863); // "(c"
+    put_32be(data, stream_offset - 4, 0x29435249); // ")CRI"
+
+    const uint16_t* key = version == 0x0409 ? key_9 : key_8;
+    uint16_t xor_key = key[0];
+    // a run of silence first now and then, find_key skips over it
+    const int silence = random.below(4) == 0 ? random.below(frames) : 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        uint8_t* bytes = &data[stream_offset + frame * 18];
+        if (frame < silence)
+        {
+            // frames of silence aren't encrypted
+            xor_key = xor_key * key[1] + key[2];
+            continue;
+        }
+        for (int i = 0; i < 18; i++)
+            bytes[i] = random.next() >> 24;
+        uint16_t scale = (bytes[0] << 8) | bytes[1];
+        if (version == 0x0408)
+            scale = (scale & ~0x6000) | (xor_key & 0x6000);
+        xor_key = xor_key * key[1] + key[2];
+        // type 9 tests the key stepped first
+        if (version == 0x0409)
+            scale = (scale & ~0x1FFF) | ((xor_key ^ random.below(0x100)) & 0x1FFF);
+        // keep the run going, an all zero frame would end it
+        scale |= scale ? 0 : 1;
+        bytes[0] = scale >> 8;
+        bytes[1] = scale;
+    }
+    return data;
+}
+
+static std::vector<uint8_t> damage(std::vector<uint8_t> data, test_random& random)
+{
+    if (random.below(4) == 0)
+    {
+        data.resize(random.below(data.size() + 1));
+        return data;
+    }
+    const size_t header_size = ((data[2] << 8) | data[3]) + 4;
+    int changes = 1 + random.below(3);
+    for (int i = 0; i < changes; i++)
+    {
+        size_t offset = random.below(random.below(4) ? std::min(header_size, data.size()) : data.size());
+        data[offset] = random.below(2) ? random.next() >> 24 : data[offset] ^ (1 << random.below(8));
+    }
+    return data;
+}
+
+static bool same_channel(const VGMSTREAMCHANNEL& a, const VGMSTREAMCHANNEL& b)
+{
+    return a.offset == b.offset && a.channel_start_offset == b.channel_start_offset &&
+        a.adpcm_coef[0] == b.adpcm_coef[0] && a.adpcm_coef[1] == b.adpcm_coef[1] &&
+        a.adx_channels == b.adx_channels && a.adx_xor == b.adx_xor &&
+        a.adx_mult == b.adx_mult && a.adx_add == b.adx_add;
+}
+
+static bool same_vgmstream(const VGMSTREAM* a, const VGMSTREAM* b)
+{
+    if (a->channels != b->channels || a->loop_flag != b->loop_flag || a->num_samples != b->num_samples ||
+        a->sample_rate != b->sample_rate || a->loop_start_sample != b->loop_start_sample ||
+        a->loop_end_sample != b->loop_end_sample || a->coding_type != b->coding_type ||
+        a->layout_type != b->layout_type || a->meta_type != b->meta_type ||
+        a->interleave_block_size != b->interleave_block_size)
+        return false;
+    for (int i = 0; i < a->channels; i++)
+    {
+        if (!same_channel(a->ch[i], b->ch[i]))
+            return false;
+        // the channels share one streamfile
+        if (!b->ch[i].streamfile || b->ch[i].streamfile != b->ch[0].streamfile)
+            return false;
+    }
+    return true;
+}
+
+/// The channels' streamfile, the reference close_vgmstream leaves it open like the library's.
+static void close_adx(VGMSTREAM* vgmstream)
+{
+    if (!vgmstream)
+        return;
+    if (vgmstream->ch[0].streamfile)
+        close_streamfile(vgmstream->ch[0].streamfile);
+    close_vgmstream(vgmstream);
+}
+
+struct comparison
+{
+    int compared;
+    int keyed;
+    /// Encrypted headers whose key find_key didn't find in the damaged data.
+    int key_lost;
+    int undefined;
+};
+
+static void compare(const std::vector<uint8_t>& data, comparison* totals)
+{
+    STREAMFILE* streamfile = open_memory_streamfile(data, "song.adx");
+    reference_undefined = false;
+    VGMSTREAM* expected = init_vgmstream_adx(streamfile);
+    if (reference_undefined)
+    {
+        close_adx(expected);
+        close_streamfile(streamfile);
+        totals->undefined++;
+        return;
+    }
+
+    const bool encrypted = expected && (expected->coding_type == coding_CRI_ADX_enc_8 || expected->coding_type == coding_CRI_ADX_enc_9);
+    for (coding_t coding_type : {coding_CRI_ADX_enc_8, coding_CRI_ADX_enc_9})
+    {
+        // the key the probe cache stores, see get_vgmstream_info
+        uint16_t key[3];
+        if (encrypted)
+        {
+            key[0] = expected->ch[0].adx_xor;
+            key[1] = expected->ch[0].adx_mult;
+            key[2] = expected->ch[0].adx_add;
+        }
+        else
+        {
+            memcpy(key, coding_type == coding_CRI_ADX_enc_8 ? key_8 : key_9, sizeof(key));
+        }
+
+        VGMSTREAM* keyed = init_vgmstream_adx_keyed(streamfile, coding_type, key);
+        if (encrypted && coding_type == expected->coding_type)
+        {
+            CHECK(keyed);
+            CHECK(same_vgmstream(expected, keyed));
+            totals->keyed++;
+        }
+        else if (keyed)
+        {
+            // only when find_key is what turned the file down, the cache never has a key for it then
+            CHECK(!expected);
+            CHECK(data.size() >= 0x14);
+            CHECK(((data[0x12] << 8) | data[0x13]) == (coding_type == coding_CRI_ADX_enc_8 ? 0x0408 : 0x0409));
+            totals->key_lost++;
+        }
+        close_adx(keyed);
+    }
+    close_adx(expected);
+    close_streamfile(streamfile);
+    totals->compared++;
+}
+
+int main(int argc, char** argv)
+{
+    comparison totals = {0, 0, 0, 0};
+    static const uint16_t versions[] = {0x0300, 0x0400, 0x0408, 0x0409};
+    test_random random(0x43);
+    for (int i = 0; i < 20000; i++)
+    {
+        std::vector<uint8_t> data = make_adx(versions[i % 4], random);
+        compare(data, &totals);
+        compare(damage(data, random), &totals);
+    }
+    printf("  %d files compared, %d opened with their key, %d with a key find_key wouldn't find, %d skipped on undefined library behavior\n",
+        totals.compared, totals.keyed, totals.key_lost, totals.undefined);
+    CHECK(totals.keyed > totals.compared / 4);
+    return 0;
+}
@@ -0,0 +1,115 @@
+/** plan_buffers over a sweep of memory budgets, channel counts and sample
+  * rates: a plan has to fit the arena it was made for, stay within the
+  * latency limits, and only be refused when memory is short.
+  */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "test_support.hpp"
+
+#include "buffer_plan.hpp"
+#include "playback_arena.hpp"
+
+/// Samples planned in steps of this, as in buffer_plan.cpp.
+static const uint32_t granularity = 1024;
+
+/// Allocates the plan's buffers the way stream_file does, from an arena of exactly the budget.
+static bool plan_fits(const buffer_plan& plan, size_t budget)
+{
+    void* heap = aligned_alloc(PLAYBACK_ARENA_ALIGNMENT, budget + PLAYBACK_ARENA_ALIGNMENT);
+    CHECK(heap);
+    playback_arena arena;
+    playback_arena_init(&arena, heap, budget);
+    bool fits = (!plan.scratch_size || playback_arena_alloc(&arena, plan.scratch_size))
+        && playback_arena_alloc(&arena, plan.buffer_size)
+        && playback_arena_alloc(&arena, plan.buffer_size);
+    free(heap);
+    return fits;
+}
+
+static void test_sweep(void)
+{
+    const size_t budgets[] = {4 << 20, 1 << 20, 256 << 10, 64 << 10, 16 << 10, 8 << 10, 2 << 10, 100, 0};
+    const int channel_counts[] = {1, 2, 6, 8, 16};
+    const int32_t sample_rates[] = {8000, 22050, 32000, 44100, 48000, 96000, 500, 1};
+    const uint32_t max_samples_values[] = {65536, 4096, 100};
+    int planned = 0;
+    int refused = 0;
+    for (size_t budget : budgets)
+    for (int channels : channel_counts)
+    for (int32_t sample_rate : sample_rates)
+    for (uint32_t max_samples : max_samples_values)
+    for (int scratch = 0; scratch < 2; scratch++)
+    {
+        buffer_plan_request request;
+        request.channels = channels;
+        request.sample_rate = sample_rate;
+        request.cost = scratch ? DECODE_COST_HEAVY : DECODE_COST_LIGHT;
+        request.scratch = scratch;
+        request.available = budget;
+        request.max_samples = max_samples;
+
+        const size_t frame_size = channels * sizeof(sample);
+        // the smallest buffers there are, one granule each
+        const size_t smallest = playback_arena_footprint(granularity * frame_size) * (scratch ? 3 : 2);
+        buffer_plan plan;
+        if (!plan_buffers(&request, &plan))
+        {
+            CHECK(smallest > budget);
+            refused++;
+            continue;
+        }
+        planned++;
+        CHECK(smallest <= budget);
+        CHECK(plan_fits(plan, budget));
+        CHECK(plan.samples >= granularity && plan.samples % granularity == 0);
+        CHECK(plan.buffer_size == plan.samples * frame_size);
+        CHECK(plan.scratch_size == (scratch ? plan.buffer_size : 0));
+        // within the latency limits, unless those are below one granule
+        uint32_t latency = std::min<uint64_t>(max_samples, static_cast<uint64_t>(sample_rate) * 1500 / 1000);
+        CHECK(plan.samples <= std::max(latency, granularity));
+        // as many granules as fit both limits
+        bool next_fits = plan.samples + granularity <= latency && plan.samples + granularity <= max_samples;
+        if (next_fits)
+        {
+            buffer_plan larger = plan;
+            larger.samples += granularity;
+            larger.buffer_size = larger.samples * frame_size;
+            larger.scratch_size = scratch ? larger.buffer_size : 0;
+            CHECK(!plan_fits(larger, budget));
+        }
+    }
+    CHECK(planned > 0 && refused > 0);
+}
+
+/// Low sample rates plan one granule where rounding down to granules left nothing.
+static void test_low_rates(void)
+{
+    for (int32_t sample_rate = 1; sample_rate < 2000; sample_rate++)
+    {
+        buffer_plan_request request = {2, sample_rate, DECODE_COST_LIGHT, false, 4 << 20, 65536};
+        buffer_plan plan;
+        CHECK(plan_buffers(&request, &plan));
+        CHECK(plan.samples == std::max<uint32_t>(sample_rate * 3 / 2 / granularity * granularity, granularity));
+    }
+}
+
+static void test_bad_requests(void)
+{
+    buffer_plan plan;
+    buffer_plan_request request = {0, 48000, DECODE_COST_LIGHT, false, 4 << 20, 65536};
+    CHECK(!plan_buffers(&request, &plan));
+    request.channels = 2;
+    request.sample_rate = 0;
+    CHECK(!plan_buffers(&request, &plan));
+}
+
+int main(int argc, char** argv)
+{
+    test_sweep();
+    test_low_rates();
+    test_bad_requests();
+    return 0;
+}
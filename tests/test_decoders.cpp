@@ -0,0 +1,450 @@
+/** The player's decoders have to give bit exact output and leave the channel
+  * in the same state as the libvgmstream decoder they replace, called a frame
+  * at a time the way decode_vgmstream calls it. Each one is checked on the
+  * read path (a plain STREAMFILE) and the peek path (every open_ext_streamfile mode).
+  */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "test_support.hpp"
+#include "vgmstream_reference.hpp"
+
+#include "decoders.hpp"
+#include "streamfile_ext.hpp"
+
+extern "C"
+{
+    #include <clHCA.h>
+    #include <coding/coding.h>
+}
+
+static const streamfile_mode ext_modes[] = {STREAMFILE_MODE_BUFFERED, STREAMFILE_MODE_MEMORY, STREAMFILE_MODE_MMAP};
+static const char* const ext_mode_names[] = {"buffered", "memory", "mmap"};
+
+/// The test file opened on the read path and then each peek path.
+static std::vector<STREAMFILE*> open_streamfiles(const std::vector<uint8_t>& data, const char* name)
+{
+    std::vector<STREAMFILE*> streamfiles;
+    streamfiles.push_back(open_memory_streamfile(data, name));
+    std::string path = write_test_file(name, data);
+    for (streamfile_mode mode : ext_modes)
+    {
+        STREAMFILE* streamfile = open_ext_streamfile(path.c_str(), mode);
+        CHECK(streamfile);
+        streamfiles.push_back(streamfile);
+    }
+    return streamfiles;
+}
+
+static void close_streamfiles(const std::vector<STREAMFILE*>& streamfiles)
+{
+    for (STREAMFILE* streamfile : streamfiles)
+        close_streamfile(streamfile);
+}
+
+static const char* streamfile_name(size_t index)
+{
+    return index == 0 ? "read" : ext_mode_names[index - 1];
+}
+
+/// Decodes with the library decoder one frame at a time, like decode_vgmstream.
+static void decode_reference(channel_decoder decode, int samples_per_frame, VGMSTREAMCHANNEL* stream,
+    sample* outbuf, int32_t first_sample, int32_t samples_to_do)
+{
+    while (samples_to_do > 0)
+    {
+        int samples = std::min(samples_per_frame - first_sample % samples_per_frame, samples_to_do);
+        decode(stream, outbuf, 1, first_sample, samples);
+        outbuf += samples;
+        first_sample += samples;
+        samples_to_do -= samples;
+    }
+}
+
+/// A player decoder and the library decoder it replaces.
+struct decoder_case
+{
+    const char* name;
+    planar_decoder planar;
+    channel_decoder reference;
+    int samples_per_frame;
+    int frame_size;
+};
+
+static const decoder_case decoder_cases[] =
+{
+    {"dsp", decode_ngc_dsp_frames, decode_ngc_dsp, 14, 8},
+    {"adx", decode_adx_frames, decode_adx, 32, 18},
+    {"adx_enc", decode_adx_enc_frames, decode_adx_enc, 32, 18},
+    {"pcm16LE", decode_pcm16LE_frames, decode_pcm16LE, 1, 2},
+    {"pcm16BE", decode_pcm16BE_frames, decode_pcm16BE, 1, 2},
+    {"pcm8", decode_pcm8_frames, decode_pcm8, 1, 1},
+    {"g721", decode_g721_frames, decode_g721, 2, 1},
+};
+
+/// Channel state any of the decoders reads, random so every arithmetic path is hit.
+static void randomize_channel(VGMSTREAMCHANNEL* stream, test_random& random)
+{
+    memset(stream, 0, sizeof(VGMSTREAMCHANNEL));
+    for (auto& coef : stream->adpcm_coef)
+        coef = random.next();
+    stream->adpcm_history1_16 = random.next();
+    stream->adpcm_history2_16 = random.next();
+    stream->adpcm_history1_32 = static_cast<int16_t>(random.next());
+    stream->adpcm_history2_32 = static_cast<int16_t>(random.next());
+    stream->adx_channels = 1 + random.below(3);
+    stream->adx_xor = random.below(0x8000);
+    stream->adx_mult = random.below(0x8000);
+    stream->adx_add = random.below(0x8000);
+    // G.721 only adapts from its initial state, arbitrary ones aren't reachable
+    g72x_init_state(&stream->g72x_state);
+}
+
+/// Channel state any of the decoders writes.
+static bool same_channel(const VGMSTREAMCHANNEL& a, const VGMSTREAMCHANNEL& b)
+{
+    return a.offset == b.offset && a.adpcm_history1_16 == b.adpcm_history1_16 &&
+        a.adpcm_history2_16 == b.adpcm_history2_16 && a.adpcm_history1_32 == b.adpcm_history1_32 &&
+        a.adpcm_history2_32 == b.adpcm_history2_32 && a.adx_xor == b.adx_xor &&
+        !memcmp(&a.g72x_state, &b.g72x_state, offsetof(g72x_state, td) + 1);
+}
+
+static void test_decoder(const decoder_case& decoder, test_random& random)
+{
+    // random frames decode to clipped noise, which exercises the saturation.
+    // An odd size leaves a partial sample or frame at the end.
+    std::vector<uint8_t> data = random.bytes(0x3000 + random.below(2));
+    std::vector<STREAMFILE*> streamfiles = open_streamfiles(data, decoder.name);
+    int total_samples = data.size() / decoder.frame_size * decoder.samples_per_frame;
+
+    for (int run = 0; run < 4000; run++)
+    {
+        VGMSTREAMCHANNEL stream;
+        randomize_channel(&stream, random);
+        stream.offset = random.below(4) * 0x400;
+        // including runs that go past the end of the file
+        int32_t first_sample = random.below(total_samples);
+        int32_t samples_to_do = 1 + random.below(random.below(2) ? 40 : 4000);
+
+        std::vector<sample> expected(samples_to_do);
+        VGMSTREAMCHANNEL expected_stream = stream;
+        expected_stream.streamfile = streamfiles[0];
+        decode_reference(decoder.reference, decoder.samples_per_frame, &expected_stream, expected.data(), first_sample, samples_to_do);
+
+        for (size_t i = 0; i < streamfiles.size(); i++)
+        {
+            std::vector<sample> decoded(samples_to_do);
+            VGMSTREAMCHANNEL decoded_stream = stream;
+            decoded_stream.streamfile = streamfiles[i];
+            decoder.planar(&decoded_stream, decoded.data(), first_sample, samples_to_do);
+            if (decoded != expected || !same_channel(decoded_stream, expected_stream))
+            {
+                fprintf(stderr, "%s %s: offset %lld, samples %d+%d\n", decoder.name, streamfile_name(i),
+                    static_cast<long long>(stream.offset), first_sample, samples_to_do);
+                CHECK(decoded == expected);
+                CHECK(same_channel(decoded_stream, expected_stream));
+            }
+        }
+    }
+    close_streamfiles(streamfiles);
+}
+
+/** Throughput of the player decoder on each path against the library decoder
+  * called a frame at a time, over a megabyte of frames.
+  */
+static void bench_decoder(const decoder_case& decoder, test_random& random)
+{
+    std::vector<uint8_t> data = random.bytes(0x100000);
+    std::vector<STREAMFILE*> streamfiles = open_streamfiles(data, decoder.name);
+    int32_t samples = data.size() / decoder.frame_size * decoder.samples_per_frame;
+    std::vector<sample> outbuf(samples);
+
+    VGMSTREAMCHANNEL stream;
+    randomize_channel(&stream, random);
+    stream.streamfile = streamfiles[0];
+    double reference_ms = time_ms([&]
+    {
+        decode_reference(decoder.reference, decoder.samples_per_frame, &stream, outbuf.data(), 0, samples);
+    });
+    printf("  %-8s library  %8.2f Msamples/s\n", decoder.name, samples / reference_ms / 1000);
+    for (size_t i = 0; i < streamfiles.size(); i++)
+    {
+        stream.streamfile = streamfiles[i];
+        double ms = time_ms([&] { decoder.planar(&stream, outbuf.data(), 0, samples); });
+        printf("  %-8s %-8s %8.2f Msamples/s, %.1fx\n", decoder.name, streamfile_name(i), samples / ms / 1000, reference_ms / ms);
+    }
+    close_streamfiles(streamfiles);
+}
+
+/** G.721 over whole files decoded in runs, so the adaptation gets far from its
+  * initial state. Besides noise the files hold tones and silence, the signals
+  * that trip tone and transition detection.
+  */
+static void test_g721_streams(test_random& random)
+{
+    for (int pattern = 0; pattern < 5; pattern++)
+    {
+        std::vector<uint8_t> data = random.bytes(1 + random.below(200000));
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            switch (pattern)
+            {
+                case 1: data[i] = (i / 3000) % 2 ? 0x77 : 0x88; break;
+                case 2: data[i] = random.below(2) ? 0x07 : 0x70; break;
+                case 3: data[i] = i % 400 < 200 ? 0x8F : 0x00; break;
+                case 4: data[i] = random.below(64) ? (i / 16) % 16 * 0x11 : data[i]; break;
+            }
+        }
+        std::vector<STREAMFILE*> streamfiles = open_streamfiles(data, "g721.bin");
+
+        VGMSTREAMCHANNEL stream;
+        randomize_channel(&stream, random);
+        stream.offset = random.below(7);
+        int32_t total_samples = data.size() * 2 + random.below(50);
+        std::vector<VGMSTREAMCHANNEL> decoded_streams(streamfiles.size(), stream);
+        VGMSTREAMCHANNEL expected_stream = stream;
+        expected_stream.streamfile = streamfiles[0];
+        for (size_t i = 0; i < streamfiles.size(); i++)
+            decoded_streams[i].streamfile = streamfiles[i];
+
+        int32_t pos = 0;
+        while (pos < total_samples)
+        {
+            int32_t samples_to_do = std::min<int32_t>(1 + random.below(5000), total_samples - pos);
+            std::vector<sample> expected(samples_to_do);
+            decode_g721(&expected_stream, expected.data(), 1, pos, samples_to_do);
+            for (size_t i = 0; i < streamfiles.size(); i++)
+            {
+                std::vector<sample> decoded(samples_to_do);
+                decode_g721_frames(&decoded_streams[i], decoded.data(), pos, samples_to_do);
+                if (decoded != expected || !same_channel(decoded_streams[i], expected_stream))
+                {
+                    fprintf(stderr, "g721 pattern %d %s: samples %d+%d\n", pattern, streamfile_name(i), pos, samples_to_do);
+                    CHECK(decoded == expected);
+                    CHECK(same_channel(decoded_streams[i], expected_stream));
+                }
+            }
+            pos += samples_to_do;
+        }
+        close_streamfiles(streamfiles);
+    }
+}
+
+// HCA
+
+/** clHCA stand-in. The decoding math is the library's own on both sides, what
+  * the test checks is which blocks reach it and where their samples go. So
+  * samples are a hash of the block, and blocks get unmasked in place the way
+  * encrypted ones are, which makes a block that's handed out twice decode
+  * differently. Blocks starting with 0xEE fail to decode.
+  */
+struct fake_clhca
+{
+    uint32_t hash;
+};
+
+extern "C" int clHCA_Decode(clHCA* hca, void* data, unsigned int size, unsigned int address)
+{
+    uint8_t* block = static_cast<uint8_t*>(data);
+    if (size == 0 || block[0] == 0xEE)
+        return -1;
+    uint32_t hash = 2166136261u ^ address;
+    for (unsigned int i = 0; i < size; i++)
+    {
+        hash = (hash ^ block[i]) * 16777619u;
+        block[i] ^= 0x5A;
+    }
+    reinterpret_cast<fake_clhca*>(hca)->hash = hash;
+    return 0;
+}
+
+extern "C" void clHCA_DecodeSamples16(clHCA* hca, signed short* samples)
+{
+    // the tests use up to 4 channels
+    uint32_t hash = reinterpret_cast<fake_clhca*>(hca)->hash;
+    for (int i = 0; i < clHCA_samplesPerBlock * 4; i++)
+        samples[i] = (hash >> (i & 15)) + i * 0x9E37;
+}
+
+static hca_codec_data* open_hca_data(STREAMFILE* streamfile, unsigned int channels, unsigned int block_size, unsigned int block_count)
+{
+    hca_codec_data* data = static_cast<hca_codec_data*>(calloc(1, sizeof(hca_codec_data) + sizeof(fake_clhca)));
+    data->streamfile = streamfile;
+    data->info.dataOffset = 0x60;
+    data->info.channelCount = channels;
+    data->info.blockSize = block_size;
+    data->info.blockCount = block_count;
+    data->sample_ptr = clHCA_samplesPerBlock;
+    return data;
+}
+
+static bool same_hca_data(const hca_codec_data* a, const hca_codec_data* b)
+{
+    return a->curblock == b->curblock && a->sample_ptr == b->sample_ptr && a->samples_discard == b->samples_discard &&
+        !memcmp(a->sample_buffer, b->sample_buffer, sizeof(a->sample_buffer));
+}
+
+/** Decodes with both decoders in runs of random length, split up at block
+  * boundaries for decode_hca like decode_vgmstream does. Now and then both
+  * jump to another block the way looping restores the codec data, the player's
+  * reader has to drop what it read ahead then.
+  */
+static void test_hca_stream(test_random& random, unsigned int block_size, unsigned int block_count, bool truncated)
+{
+    unsigned int channels = 1 + random.below(4);
+    size_t file_blocks = truncated ? block_count / 2 : block_count;
+    std::vector<uint8_t> file = random.bytes(0x60 + file_blocks * block_size + (truncated ? block_size / 2 : 0));
+    for (size_t i = 0x60; i < file.size(); i++)
+    {
+        // an undecodable block now and then
+        if (file[i] == 0xEE && random.below(8))
+            file[i] = 0;
+    }
+    STREAMFILE* streamfile = open_memory_streamfile(file, "hca.bin");
+
+    hca_codec_data* expected = open_hca_data(streamfile, channels, block_size, block_count);
+    hca_codec_data* decoded = open_hca_data(streamfile, channels, block_size, block_count);
+    expected->samples_discard = decoded->samples_discard = random.below(3000);
+
+    VGMSTREAM vgmstream;
+    memset(&vgmstream, 0, sizeof(vgmstream));
+    vgmstream.channels = channels;
+    vgmstream.coding_type = coding_CRI_HCA;
+    vgmstream.codec_data = decoded;
+    void* reader = open_hca_reader(&vgmstream);
+
+    int32_t total_samples = (block_count + 2) * clHCA_samplesPerBlock;
+    std::vector<sample> interleaved(total_samples * channels, 0x1234);
+    std::vector<std::vector<sample>> planar(channels, std::vector<sample>(total_samples, 0x1234));
+    std::vector<sample*> planar_channels;
+    for (auto& channel : planar)
+        planar_channels.push_back(channel.data());
+
+    int32_t pos = 0;
+    while (pos < total_samples)
+    {
+        if (random.below(10) == 0)
+        {
+            unsigned int block = random.below(block_count);
+            unsigned int discard = random.below(clHCA_samplesPerBlock);
+            for (hca_codec_data* data : {expected, decoded})
+            {
+                data->curblock = block;
+                data->sample_ptr = clHCA_samplesPerBlock;
+                data->samples_discard = discard;
+            }
+        }
+
+        int32_t samples_to_do = std::min<int32_t>(1 + random.below(3000), total_samples - pos);
+        for (int32_t done = 0; done < samples_to_do;)
+        {
+            int32_t samples = std::min<int32_t>(samples_to_do - done, clHCA_samplesPerBlock - (pos + done) % clHCA_samplesPerBlock);
+            decode_hca(expected, interleaved.data() + (pos + done) * channels, samples, channels);
+            done += samples;
+        }
+        vgmstream.samples_into_block = pos;
+        decode_hca_planar(&vgmstream, reader, planar_channels.data(), pos, samples_to_do);
+
+        for (int32_t i = pos; i < pos + samples_to_do; i++)
+        {
+            for (unsigned int chan = 0; chan < channels; chan++)
+            {
+                if (planar[chan][i] != interleaved[i * channels + chan])
+                {
+                    fprintf(stderr, "hca block size %u: sample %d of channel %u\n", block_size, i, chan);
+                    CHECK(planar[chan][i] == interleaved[i * channels + chan]);
+                }
+            }
+        }
+        CHECK(same_hca_data(expected, decoded));
+        pos += samples_to_do;
+    }
+
+    close_hca_reader(reader);
+    free(expected);
+    free(decoded);
+    close_streamfile(streamfile);
+}
+
+static void test_hca(test_random& random)
+{
+    // a block at most, several per fetch and blocks that don't divide the fetch size
+    static const unsigned int block_sizes[] = {0x155, 0x400, 0x2001, 0x5000};
+    for (unsigned int block_size : block_sizes)
+    {
+        for (int run = 0; run < 20; run++)
+            test_hca_stream(random, block_size, 1 + random.below(60), run & 1);
+    }
+}
+
+static void bench_hca(test_random& random)
+{
+    const unsigned int block_size = 0x155;
+    const unsigned int block_count = 4000;
+    const unsigned int channels = 2;
+    std::vector<uint8_t> file = random.bytes(0x60 + block_count * block_size);
+    for (size_t i = 0x60; i < file.size(); i += block_size)
+        file[i] = 0;
+    STREAMFILE* streamfile = open_memory_streamfile(file, "hca_bench.bin");
+    int32_t samples = block_count * clHCA_samplesPerBlock;
+    // how the render loop asks for them, a playback buffer at a time
+    const int32_t request = 0x1000;
+
+    std::vector<sample> interleaved(samples * channels);
+    hca_codec_data* data = open_hca_data(streamfile, channels, block_size, block_count);
+    size_t reads = memory_streamfile_reads();
+    double reference_ms = time_ms([&]
+    {
+        data->curblock = 0;
+        data->sample_ptr = clHCA_samplesPerBlock;
+        for (int32_t pos = 0; pos < samples; pos += clHCA_samplesPerBlock)
+            decode_hca(data, interleaved.data() + pos * channels, clHCA_samplesPerBlock, channels);
+    });
+    size_t reference_reads = (memory_streamfile_reads() - reads) / 5;
+
+    std::vector<std::vector<sample>> planar(channels, std::vector<sample>(samples));
+    VGMSTREAM vgmstream;
+    memset(&vgmstream, 0, sizeof(vgmstream));
+    vgmstream.channels = channels;
+    vgmstream.codec_data = data;
+    void* reader = open_hca_reader(&vgmstream);
+    reads = memory_streamfile_reads();
+    double ms = time_ms([&]
+    {
+        data->curblock = 0;
+        data->sample_ptr = clHCA_samplesPerBlock;
+        for (int32_t pos = 0; pos < samples; pos += request)
+        {
+            sample* out[channels] = {planar[0].data(), planar[1].data()};
+            vgmstream.samples_into_block = pos;
+            decode_hca_planar(&vgmstream, reader, out, pos, request);
+        }
+    });
+    size_t planar_reads = (memory_streamfile_reads() - reads) / 5;
+    close_hca_reader(reader);
+    free(data);
+    close_streamfile(streamfile);
+
+    // both sides run the same stand-in clHCA, so this is the cost around the decoder
+    printf("  hca      library  %8.2f ms, %zu reads\n", reference_ms, reference_reads);
+    printf("  hca      planar   %8.2f ms, %zu reads, %.1fx\n", ms, planar_reads, reference_ms / ms);
+}
+
+int main(int argc, char** argv)
+{
+    test_random random(0xD5);
+    for (const auto& decoder : decoder_cases)
+        test_decoder(decoder, random);
+    test_g721_streams(random);
+    test_hca(random);
+
+    if (bench_requested(argc, argv))
+    {
+        for (const auto& decoder : decoder_cases)
+            bench_decoder(decoder, random);
+        bench_hca(random);
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+/** The playback arena over a fake linear heap, a block aligned like
+  * linearAlloc's: what it hands out has to stay aligned and inside the block,
+  * sizes that overflow the rounding have to be refused, and a reset has to
+  * give the whole block back while the high water mark stays.
+  */
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "test_support.hpp"
+
+#include "playback_arena.hpp"
+
+/// Songs of random channel counts, each taking the raw buffer and both playback buffers.
+static void test_songs(test_random& random)
+{
+    const size_t heap_size = 4 << 20;
+    uint8_t* heap = static_cast<uint8_t*>(aligned_alloc(PLAYBACK_ARENA_ALIGNMENT, heap_size));
+    CHECK(heap);
+    playback_arena arena;
+    playback_arena_init(&arena, heap, heap_size);
+
+    size_t high_water = 0;
+    for (int song = 0; song < 1000; song++)
+    {
+        size_t used = 0;
+        while (true)
+        {
+            size_t size = 1 + random.below(0x40000);
+            size_t available = playback_arena_available(&arena);
+            CHECK(available == heap_size - used);
+            uint8_t* memory = static_cast<uint8_t*>(playback_arena_alloc(&arena, size));
+            if (!memory)
+            {
+                // refused only when it really doesn't fit, and leaves the arena as it was
+                CHECK(playback_arena_footprint(size) > available);
+                CHECK(playback_arena_available(&arena) == available);
+                break;
+            }
+            CHECK(reinterpret_cast<uintptr_t>(memory) % PLAYBACK_ARENA_ALIGNMENT == 0);
+            CHECK(memory == heap + used);
+            CHECK(playback_arena_footprint(size) >= size);
+            CHECK(playback_arena_footprint(size) - size < PLAYBACK_ARENA_ALIGNMENT);
+            used += playback_arena_footprint(size);
+            CHECK(used <= heap_size);
+            if (used > high_water)
+                high_water = used;
+            if (random.below(4) == 0)
+                break;
+        }
+        CHECK(arena.high_water == high_water);
+        playback_arena_reset(&arena);
+        CHECK(playback_arena_available(&arena) == heap_size);
+        CHECK(arena.high_water == high_water);
+    }
+    free(heap);
+}
+
+static void test_limits(void)
+{
+    const size_t heap_size = 0x1000;
+    void* heap = aligned_alloc(PLAYBACK_ARENA_ALIGNMENT, heap_size);
+    CHECK(heap);
+    playback_arena arena;
+    playback_arena_init(&arena, heap, heap_size);
+
+    // sizes whose rounding wraps around
+    CHECK(!playback_arena_alloc(&arena, SIZE_MAX));
+    CHECK(!playback_arena_alloc(&arena, SIZE_MAX - PLAYBACK_ARENA_ALIGNMENT + 2));
+    CHECK(!playback_arena_alloc(&arena, heap_size + 1));
+    CHECK(playback_arena_available(&arena) == heap_size);
+    CHECK(arena.high_water == 0);
+
+    // an exact fit, then nothing more
+    CHECK(playback_arena_alloc(&arena, 3) == heap);
+    CHECK(playback_arena_available(&arena) == heap_size - PLAYBACK_ARENA_ALIGNMENT);
+    CHECK(playback_arena_alloc(&arena, heap_size - PLAYBACK_ARENA_ALIGNMENT));
+    CHECK(playback_arena_available(&arena) == 0);
+    CHECK(!playback_arena_alloc(&arena, 1));
+    CHECK(arena.high_water == heap_size);
+
+    // a 0 byte allocation takes nothing
+    playback_arena_reset(&arena);
+    CHECK(playback_arena_alloc(&arena, 0) == heap);
+    CHECK(playback_arena_available(&arena) == heap_size);
+    free(heap);
+
+    // no block, as when linearAlloc failed
+    playback_arena_init(&arena, NULL, heap_size);
+    CHECK(playback_arena_available(&arena) == 0);
+    CHECK(!playback_arena_alloc(&arena, 1));
+}
+
+int main(int argc, char** argv)
+{
+    test_random random(0x49);
+    test_songs(random);
+    test_limits();
+    return 0;
+}
@@ -0,0 +1,374 @@
+/** parse_vgmstream_info has to accept and describe exactly the files the
+  * init_vgmstream_* probe it stands in for opens. Valid headers of every parsed
+  * format are checked against the reference metas, then randomly damaged and
+  * truncated copies of them.
+  */
+
+#include <cstring>
+#include <strings.h>
+
+#include "test_support.hpp"
+#include "vgmstream_reference.hpp"
+
+#include "detect.hpp"
+#include "probe_info.hpp"
+
+extern "C"
+{
+    #include <clHCA.h>
+    #include <meta/meta.h>
+}
+
+// detect.cpp stand-ins, the parsed probes and their index entries
+
+static VGMSTREAM* (*const probes[])(STREAMFILE*) =
+{
+    init_vgmstream_bcstm,
+    init_vgmstream_hca,
+    init_vgmstream_ahx,
+};
+
+static const struct
+{
+    const char* extension;
+    const char* magic;
+    int magic_size;
+} index_entries[] =
+{
+    {"bcstm", "CSTM", 4},
+    {"hca", NULL, 0},
+    {"ahx", "\x80\x00", 2},
+};
+
+int detect_probe_count(void)
+{
+    return sizeof(probes) / sizeof(probes[0]);
+}
+
+int detect_find_probe(VGMSTREAM* (*probe)(STREAMFILE*))
+{
+    for (int i = 0; i < detect_probe_count(); i++)
+    {
+        if (probes[i] == probe)
+            return i;
+    }
+    return -1;
+}
+
+int detect_candidates(STREAMFILE* streamfile, int* candidates)
+{
+    char filename[PATH_LIMIT];
+    streamfile->get_name(streamfile, filename, sizeof(filename));
+    uint8_t magic[4];
+    size_t magic_read = read_streamfile(magic, 0, sizeof(magic), streamfile);
+
+    int count = 0;
+    for (int i = 0; i < detect_probe_count(); i++)
+    {
+        const auto& entry = index_entries[i];
+        if (strcasecmp(entry.extension, filename_extension(filename)))
+            continue;
+        if (entry.magic_size && (magic_read < static_cast<size_t>(entry.magic_size) || memcmp(magic, entry.magic, entry.magic_size)))
+            continue;
+        candidates[count++] = i;
+    }
+    return count;
+}
+
+VGMSTREAM* detect_vgmstream(STREAMFILE*, detect_stats*, const vgmstream_info*)
+{
+    CHECK(!"parse_vgmstream_info never opens files");
+    return NULL;
+}
+
+// sample files
+
+static void put_16le(std::vector<uint8_t>& data, size_t offset, uint16_t value)
+{
+    data[offset] = value;
+    data[offset + 1] = value >> 8;
+}
+
+static void put_32le(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+{
+    put_16le(data, offset, value);
+    put_16le(data, offset + 2, value >> 16);
+}
+
+static void put_16be(std::vector<uint8_t>& data, size_t offset, uint16_t value)
+{
+    data[offset] = value >> 8;
+    data[offset + 1] = value;
+}
+
+static void put_32be(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+{
+    put_16be(data, offset, value >> 16);
+    put_16be(data, offset + 2, value);
+}
+
+static std::vector<uint8_t> make_bcstm(int codec, bool seek_block, int channels, bool loop, uint32_t loop_start)
+{
+    std::vector<uint8_t> data(0x100);
+    put_32be(data, 0x00, 0x4353544D); // "CSTM"
+    put_16le(data, 0x04, 0xFEFF);
+    put_16le(data, 0x10, 3);
+    put_16le(data, 0x14, 0x4000);
+    put_32le(data, 0x18, 0x40);
+    put_16le(data, 0x20, 0x4001);
+    put_32le(data, 0x24, 0x80);
+    put_16le(data, 0x2C, 0x4002);
+    put_32le(data, 0x30, 0xC0);
+
+    data[0x40 + 0x20] = codec;
+    data[0x40 + 0x21] = loop;
+    data[0x40 + 0x22] = channels;
+    put_16le(data, 0x40 + 0x24, 32728);
+    put_32le(data, 0x40 + 0x28, loop_start);
+    put_32le(data, 0x40 + 0x2C, 1000000);
+    if (seek_block)
+        put_32be(data, 0x80, 0x5345454B); // "SEEK"
+    return data;
+}
+
+static uint16_t hca_checksum(const uint8_t* data, size_t size)
+{
+    uint16_t sum = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        sum ^= data[i] << 8;
+        for (int j = 0; j < 8; j++)
+            sum = (sum & 0x8000) ? (sum << 1) ^ 0x8005 : sum << 1;
+    }
+    return sum;
+}
+
+/// Makes the checksum of the header data claims to have match again, if it fits.
+static void fix_hca_checksum(std::vector<uint8_t>& data)
+{
+    if (data.size() < 8)
+        return;
+    size_t header_size = data[6] << 8 | data[7];
+    if (header_size < 2 || header_size > data.size())
+        return;
+    put_16be(data, header_size - 2, hca_checksum(data.data(), header_size - 2));
+}
+
+static std::vector<uint8_t> make_hca(int channels, bool dec_chunk, bool loop, bool cipher, bool encrypted_ids)
+{
+    std::vector<uint8_t> data(0x60);
+    size_t chunk = 0;
+    auto put_id = [&](uint32_t id)
+    {
+        put_32be(data, chunk, encrypted_ids ? id | 0x80808080 : id);
+    };
+
+    put_id(0x48434100); // "HCA\0"
+    put_16be(data, 0x04, 0x0200);
+    chunk = 0x08;
+    put_id(0x666D7400); // "fmt\0"
+    data[0x0C] = channels;
+    put_32be(data, 0x0C, channels << 24 | 44100);
+    put_32be(data, 0x10, 300);
+    chunk = 0x18;
+    if (dec_chunk)
+    {
+        put_id(0x64656300); // "dec\0"
+        put_16be(data, chunk + 4, 0x200);
+        data[chunk + 6] = 1;
+        data[chunk + 7] = 15;
+        chunk += 12;
+    }
+    else
+    {
+        put_id(0x636F6D70); // "comp"
+        put_16be(data, chunk + 4, 0x200);
+        data[chunk + 6] = 1;
+        data[chunk + 7] = 15;
+        chunk += 16;
+    }
+    if (loop)
+    {
+        put_id(0x6C6F6F70); // "loop"
+        put_32be(data, chunk + 4, 20);
+        put_32be(data, chunk + 8, 250);
+        chunk += 16;
+    }
+    if (cipher)
+    {
+        put_id(0x63697068); // "ciph"
+        put_16be(data, chunk + 4, 1);
+        chunk += 6;
+    }
+    put_16be(data, 0x06, chunk + 2);
+    fix_hca_checksum(data);
+    return data;
+}
+
+static std::vector<uint8_t> make_ahx(uint32_t sample_rate)
+{
+    std::vector<uint8_t> data(0x40);
+    put_16be(data, 0x00, 0x8000);
+    put_16be(data, 0x02, 0x1C);
+    data[0x04] = 0x11;
+    data[0x07] = 1;
+    put_32be(data, 0x08, sample_rate);
+    put_32be(data, 0x0C, 123456);
+    put_16be(data, 0x1A, 0x2863); // "(c"
+    put_32be(data, 0x1C, 0x29435249); // ")CRI"
+    return data;
+}
+
+struct sample_file
+{
+    const char* name;
+    VGMSTREAM* (*probe)(STREAMFILE*);
+    std::vector<uint8_t> data;
+};
+
+static std::vector<sample_file> base_files(void)
+{
+    return
+    {
+        {"song.bcstm", init_vgmstream_bcstm, make_bcstm(0, false, 1, false, 0)},
+        {"song.bcstm", init_vgmstream_bcstm, make_bcstm(1, false, 2, true, 4000)},
+        {"song.bcstm", init_vgmstream_bcstm, make_bcstm(2, true, 2, true, 20000)},
+        {"song.bcstm", init_vgmstream_bcstm, make_bcstm(2, false, 2, true, 20000)},
+        {"song.bcstm", init_vgmstream_bcstm, make_bcstm(2, false, 1, true, 2000)},
+        {"song.hca", init_vgmstream_hca, make_hca(2, false, true, true, false)},
+        {"song.hca", init_vgmstream_hca, make_hca(1, true, false, false, true)},
+        {"song.hca", init_vgmstream_hca, make_hca(6, false, false, true, true)},
+        {"song.ahx", init_vgmstream_ahx, make_ahx(44100)},
+        {"song.ahx", init_vgmstream_ahx, make_ahx(500)},
+    };
+}
+
+// comparison
+
+/// What the library's probe makes of the file, including finish_vgmstream's sample rate check.
+static bool reference_info(const sample_file& file, STREAMFILE* streamfile, vgmstream_info* info)
+{
+    VGMSTREAM* vgmstream = file.probe(streamfile);
+    if (!vgmstream)
+        return false;
+    bool accepted = check_sample_rate(vgmstream->sample_rate);
+    if (accepted)
+        get_vgmstream_info(vgmstream, detect_find_probe(file.probe), info);
+    close_vgmstream(vgmstream);
+    return accepted;
+}
+
+static bool same_info(const vgmstream_info& a, const vgmstream_info& b)
+{
+    return a.probe == b.probe && a.meta_type == b.meta_type && a.coding_type == b.coding_type &&
+        a.layout_type == b.layout_type && a.channels == b.channels && a.loop_flag == b.loop_flag &&
+        a.sample_rate == b.sample_rate && a.num_samples == b.num_samples &&
+        a.loop_start_sample == b.loop_start_sample && a.loop_end_sample == b.loop_end_sample;
+}
+
+struct comparison
+{
+    int compared;
+    int accepted;
+    int undefined;
+};
+
+static void compare(const sample_file& file, comparison* totals)
+{
+    STREAMFILE* streamfile = open_memory_streamfile(file.data, file.name);
+    vgmstream_info expected, parsed;
+    memset(&expected, 0, sizeof(expected));
+    memset(&parsed, 0, sizeof(parsed));
+
+    reference_undefined = false;
+    bool reference_accepted = reference_info(file, streamfile, &expected);
+    if (reference_undefined)
+    {
+        totals->undefined++;
+        close_streamfile(streamfile);
+        return;
+    }
+
+    bool parse_accepted = parse_vgmstream_info(streamfile, &parsed);
+    close_streamfile(streamfile);
+    if (parse_accepted != reference_accepted || (parse_accepted && !same_info(parsed, expected)))
+    {
+        fprintf(stderr, "%s (%zu bytes): reference %s, parsed %s\n", file.name, file.data.size(),
+            reference_accepted ? "accepts" : "rejects", parse_accepted ? "accepts" : "rejects");
+        for (uint8_t byte : file.data)
+            fprintf(stderr, "%02X", byte);
+        fprintf(stderr, "\n");
+        CHECK(parse_accepted == reference_accepted);
+        CHECK(same_info(parsed, expected));
+    }
+    totals->compared++;
+    totals->accepted += parse_accepted;
+}
+
+static sample_file damage(const sample_file& base, test_random& random)
+{
+    sample_file file = base;
+    if (random.below(4) == 0)
+    {
+        file.data.resize(random.below(file.data.size() + 1));
+    }
+    else
+    {
+        // headers are all near the start, damage that mostly
+        int changes = 1 + random.below(4);
+        for (int i = 0; i < changes; i++)
+        {
+            size_t offset = random.below(random.below(2) ? 0x30 : file.data.size());
+            file.data[offset] = random.below(2) ? random.next() >> 24 : file.data[offset] ^ (1 << random.below(8));
+        }
+    }
+    if (base.probe == init_vgmstream_hca && random.below(2))
+        fix_hca_checksum(file.data);
+    return file;
+}
+
+int main(int argc, char** argv)
+{
+    comparison totals = {0, 0, 0};
+    std::vector<sample_file> files = base_files();
+    for (const auto& file : files)
+        compare(file, &totals);
+    CHECK(totals.accepted == 9); // all but the AHX at 500 Hz
+
+    test_random random(0x3D5);
+    for (int i = 0; i < 200000; i++)
+        compare(damage(files[random.below(files.size())], random), &totals);
+    printf("  %d files compared, %d accepted, %d skipped on undefined library behavior\n",
+        totals.compared, totals.accepted, totals.undefined);
+
+    if (bench_requested(argc, argv))
+    {
+        // the host can't show what the full init costs on the 3DS on top of this:
+        // channel streamfiles being opened, clHCA's state allocated and mpg123 started
+        for (const auto& file : files)
+        {
+            vgmstream_info info;
+            size_t reads = memory_streamfile_reads();
+            STREAMFILE* streamfile = open_memory_streamfile(file.data, file.name);
+            double parse_ms = time_ms([&]
+            {
+                for (int i = 0; i < 10000; i++)
+                    parse_vgmstream_info(streamfile, &info);
+            });
+            size_t parse_reads = (memory_streamfile_reads() - reads) / 5 / 10000;
+
+            reads = memory_streamfile_reads();
+            double reference_ms = time_ms([&]
+            {
+                for (int i = 0; i < 10000; i++)
+                    reference_info(file, streamfile, &info);
+            });
+            size_t reference_reads = (memory_streamfile_reads() - reads) / 5 / 10000;
+            close_streamfile(streamfile);
+
+            printf("  %-10s parse %7.2f us %3zu reads, init_vgmstream %7.2f us %3zu reads\n", file.name,
+                parse_ms * 1000 / 10000, parse_reads, reference_ms * 1000 / 10000, reference_reads);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+/** render_pool_run has to give the same result as running the jobs one after
+  * another, whatever the worker count and however the calls follow each other,
+  * and has to run every job exactly once before it returns. Jobs that read one
+  * buffered streamfile, as child streams of AIX and SCD interleave streams do,
+  * have to read what's in the file.
+  */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "test_support.hpp"
+
+#include "render_pool.hpp"
+#include "streamfile_ext.hpp"
+
+struct job_results
+{
+    /// Work each job does, so jobs of one call take different times.
+    std::vector<uint32_t> rounds;
+    std::vector<uint32_t> output;
+    std::unique_ptr<std::atomic<int>[]> runs;
+};
+
+/// CPU bound stand-in for rendering a child stream, each index writes only its own slot.
+static void hash_job(void* arg, int index)
+{
+    job_results* results = static_cast<job_results*>(arg);
+    uint32_t hash = 2166136261u ^ index;
+    for (uint32_t i = 0; i < results->rounds[index]; i++)
+        hash = (hash ^ i) * 16777619u;
+    results->output[index] = hash;
+    results->runs[index]++;
+}
+
+static job_results make_results(const std::vector<uint32_t>& rounds)
+{
+    job_results results;
+    results.rounds = rounds;
+    results.output.assign(rounds.size(), 0);
+    results.runs.reset(new std::atomic<int>[rounds.size() + 1]);
+    for (size_t i = 0; i < rounds.size(); i++)
+        results.runs[i] = 0;
+    return results;
+}
+
+/// Many calls of varying size through one pool, each against the serial result.
+static void test_pool(int workers, test_random& random)
+{
+    render_pool* pool = render_pool_open(workers);
+    CHECK((pool == NULL) == (workers <= 0));
+    for (int call = 0; call < 2000; call++)
+    {
+        int job_count = random.below(10);
+        uint32_t max_rounds = 1 + random.below(20000);
+        std::vector<uint32_t> rounds;
+        for (int i = 0; i < job_count; i++)
+            rounds.push_back(random.below(max_rounds));
+        job_results serial = make_results(rounds);
+        for (int i = 0; i < job_count; i++)
+            hash_job(&serial, i);
+
+        job_results results = make_results(rounds);
+        render_pool_run(pool, hash_job, &results, job_count);
+        CHECK(results.output == serial.output);
+        for (int i = 0; i < job_count; i++)
+            CHECK(results.runs[i] == 1);
+    }
+    render_pool_close(pool);
+}
+
+struct shared_reads
+{
+    STREAMFILE* streamfile;
+    const std::vector<uint8_t>* data;
+    /// Seeds the reads of each job.
+    std::vector<uint32_t> seeds;
+    /// Reads of each job that didn't match the file.
+    std::vector<int> mismatches;
+};
+
+/// Reads of every size at offsets all over the file, each refilling the shared buffer from under the other jobs.
+static void read_job(void* arg, int index)
+{
+    shared_reads* reads = static_cast<shared_reads*>(arg);
+    const std::vector<uint8_t>& data = *reads->data;
+    test_random random(reads->seeds[index]);
+    std::vector<uint8_t> dest;
+    for (int i = 0; i < 300; i++)
+    {
+        size_t offset = random.below(data.size());
+        size_t length = 1 + random.below(random.below(4) ? 0x40 : 0x1000);
+        size_t expected = std::min(length, data.size() - offset);
+        dest.assign(length, 0);
+        if (read_streamfile(dest.data(), offset, length, reads->streamfile) != expected
+            || !std::equal(dest.begin(), dest.begin() + expected, data.begin() + offset))
+            reads->mismatches[index]++;
+    }
+}
+
+static void test_shared_streamfile(int workers, test_random& random)
+{
+    std::vector<uint8_t> data = random.bytes(0x40000);
+    std::string path = write_test_file("shared.bin", data);
+    // a small buffer, so nearly every read refills it
+    STREAMFILE* streamfile = open_ext_streamfile(path.c_str(), STREAMFILE_MODE_BUFFERED, 0x400);
+    CHECK(streamfile);
+
+    render_pool* pool = render_pool_open(workers);
+    for (int call = 0; call < 20; call++)
+    {
+        shared_reads reads;
+        reads.streamfile = streamfile;
+        reads.data = &data;
+        int job_count = 2 + random.below(5);
+        for (int i = 0; i < job_count; i++)
+            reads.seeds.push_back(random.next());
+        reads.mismatches.assign(job_count, 0);
+        render_pool_run(pool, read_job, &reads, job_count);
+        for (int i = 0; i < job_count; i++)
+            CHECK(reads.mismatches[i] == 0);
+    }
+    render_pool_close(pool);
+    close_streamfile(streamfile);
+}
+
+/** Speed-up of a call of CPU bound jobs as the render loop makes them, one per
+  * child stream. render.cpp asks for at most two workers, so with the calling
+  * thread three jobs run side by side and more than three gain nothing further.
+  * Speed-up also needs the cores, so they're printed alongside.
+  */
+static void bench_pool(void)
+{
+    printf("  %u cores\n", std::thread::hardware_concurrency());
+    const int job_counts[] = {2, 3, 6};
+    for (int job_count : job_counts)
+    {
+        job_results results = make_results(std::vector<uint32_t>(job_count, 20000000));
+        double serial_ms = 0;
+        for (int workers = 0; workers <= 2; workers++)
+        {
+            render_pool* pool = render_pool_open(workers);
+            double ms = time_ms([&] { render_pool_run(pool, hash_job, &results, job_count); }, 3);
+            render_pool_close(pool);
+            if (workers == 0)
+                serial_ms = ms;
+            printf("  %d jobs, %d workers %8.2f ms, %.1fx\n", job_count, workers, ms, serial_ms / ms);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    test_random random(0x46);
+    for (int workers = 0; workers <= 3; workers++)
+        test_pool(workers, random);
+    for (int workers = 0; workers <= 2; workers++)
+        test_shared_streamfile(workers, random);
+
+    if (bench_requested(argc, argv))
+        bench_pool();
+    return 0;
+}
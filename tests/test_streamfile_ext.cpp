@@ -0,0 +1,89 @@
+/** Memory streamfiles load whole files, so open_ext_streamfile_limited has to
+  * keep the companion files vgmstream opens through one (channels, dual file
+  * stereo, header/data pairs) within the same limit as the file itself.
+  */
+
+#include <cstring>
+
+#include "test_support.hpp"
+
+#include "streamfile_ext.hpp"
+
+static streamfile_mode get_mode(STREAMFILE* streamfile)
+{
+    CHECK(is_ext_streamfile(streamfile));
+    return reinterpret_cast<ext_streamfile*>(streamfile)->mode;
+}
+
+/// Opens filename the way vgmstream opens companion files.
+static STREAMFILE* open_companion(STREAMFILE* streamfile, const char* filename)
+{
+    return streamfile->open(streamfile, filename, STREAMFILE_DEFAULT_BUFFER_SIZE);
+}
+
+/// Whole content of streamfile read through vgmstream's STREAMFILE interface.
+static std::vector<uint8_t> read_all(STREAMFILE* streamfile)
+{
+    std::vector<uint8_t> data(get_streamfile_size(streamfile));
+    CHECK(read_streamfile(data.data(), 0, data.size(), streamfile) == data.size());
+    return data;
+}
+
+static void test_companion_limit(test_random& random)
+{
+    const off_t limit = 0x10000;
+    std::vector<uint8_t> header = random.bytes(0x800);
+    std::vector<uint8_t> small = random.bytes(limit);
+    std::vector<uint8_t> large = random.bytes(limit + 1);
+    std::string header_path = write_test_file("limit_header.bin", header);
+    std::string small_path = write_test_file("limit_small.bin", small);
+    std::string large_path = write_test_file("limit_large.bin", large);
+
+    STREAMFILE* streamfile = open_ext_streamfile_limited(header_path.c_str(), limit);
+    CHECK(streamfile);
+    CHECK(get_mode(streamfile) == STREAMFILE_MODE_MEMORY);
+    CHECK(read_all(streamfile) == header);
+
+    // companions up to the limit are loaded, bigger ones are buffered, their own companions too
+    STREAMFILE* companion = open_companion(streamfile, small_path.c_str());
+    CHECK(companion);
+    CHECK(get_mode(companion) == STREAMFILE_MODE_MEMORY);
+    CHECK(read_all(companion) == small);
+    STREAMFILE* nested = open_companion(companion, large_path.c_str());
+    CHECK(nested);
+    CHECK(get_mode(nested) == STREAMFILE_MODE_BUFFERED);
+    CHECK(read_all(nested) == large);
+    close_streamfile(nested);
+    close_streamfile(companion);
+
+    companion = open_companion(streamfile, large_path.c_str());
+    CHECK(companion);
+    CHECK(get_mode(companion) == STREAMFILE_MODE_BUFFERED);
+    CHECK(read_all(companion) == large);
+    close_streamfile(companion);
+    close_streamfile(streamfile);
+
+    // the file itself is held to the limit as well
+    streamfile = open_ext_streamfile_limited(large_path.c_str(), limit);
+    CHECK(streamfile);
+    CHECK(get_mode(streamfile) == STREAMFILE_MODE_BUFFERED);
+    close_streamfile(streamfile);
+
+    // asked for memory mode outright, everything is loaded as before
+    streamfile = open_ext_streamfile(header_path.c_str(), STREAMFILE_MODE_MEMORY);
+    CHECK(streamfile);
+    companion = open_companion(streamfile, large_path.c_str());
+    CHECK(companion);
+    CHECK(get_mode(companion) == STREAMFILE_MODE_MEMORY);
+    close_streamfile(companion);
+    close_streamfile(streamfile);
+
+    CHECK(!open_ext_streamfile_limited((header_path + ".missing").c_str(), limit));
+}
+
+int main(int argc, char** argv)
+{
+    test_random random(0x26);
+    test_companion_limit(random);
+    return 0;
+}
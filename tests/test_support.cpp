@@ -0,0 +1,123 @@
+#include "test_support.hpp"
+
+#include <cstring>
+#include <memory>
+#include <dirent.h>
+#include <unistd.h>
+
+struct memory_streamfile
+{
+    STREAMFILE sf;
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    std::string name;
+};
+
+static size_t reads = 0;
+
+static size_t memory_read(STREAMFILE* streamfile, uint8_t* dest, off_t offset, size_t length)
+{
+    const std::vector<uint8_t>& data = *reinterpret_cast<memory_streamfile*>(streamfile)->data;
+    reads++;
+    if (offset < 0 || static_cast<size_t>(offset) >= data.size())
+        return 0;
+    size_t available = data.size() - offset;
+    if (length > available)
+        length = available;
+    memcpy(dest, data.data() + offset, length);
+    return length;
+}
+
+static size_t memory_get_size(STREAMFILE* streamfile)
+{
+    return reinterpret_cast<memory_streamfile*>(streamfile)->data->size();
+}
+
+static off_t memory_get_offset(STREAMFILE*)
+{
+    return 0;
+}
+
+static void memory_get_name(STREAMFILE* streamfile, char* name, size_t length)
+{
+    strncpy(name, reinterpret_cast<memory_streamfile*>(streamfile)->name.c_str(), length);
+    name[length - 1] = '\0';
+}
+
+static void memory_close(STREAMFILE* streamfile)
+{
+    delete reinterpret_cast<memory_streamfile*>(streamfile);
+}
+
+static STREAMFILE* open_memory(std::shared_ptr<const std::vector<uint8_t>> data, const char* name)
+{
+    memory_streamfile* memory = new memory_streamfile();
+    memory->sf.read = memory_read;
+    memory->sf.get_size = memory_get_size;
+    memory->sf.get_offset = memory_get_offset;
+    memory->sf.get_name = memory_get_name;
+    memory->sf.get_realname = memory_get_name;
+    memory->sf.open = [](STREAMFILE* streamfile, const char* const filename, size_t)
+    {
+        // channels and companion files all come from the same data
+        return open_memory(reinterpret_cast<memory_streamfile*>(streamfile)->data, filename);
+    };
+    memory->sf.close = memory_close;
+    memory->data = data;
+    memory->name = name;
+    return &memory->sf;
+}
+
+STREAMFILE* open_memory_streamfile(const std::vector<uint8_t>& data, const char* name)
+{
+    return open_memory(std::make_shared<const std::vector<uint8_t>>(data), name);
+}
+
+size_t memory_streamfile_reads(void)
+{
+    return reads;
+}
+
+static std::string test_directory;
+
+static void remove_test_directory(void)
+{
+    DIR* dir = opendir(test_directory.c_str());
+    if (dir)
+    {
+        while (dirent* entry = readdir(dir))
+        {
+            if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+                unlink((test_directory + "/" + entry->d_name).c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(test_directory.c_str());
+}
+
+std::string write_test_file(const char* name, const std::vector<uint8_t>& data)
+{
+    if (test_directory.empty())
+    {
+        char pattern[] = "/tmp/3ds-vgmstream-test-XXXXXX";
+        CHECK(mkdtemp(pattern));
+        test_directory = pattern;
+        atexit(remove_test_directory);
+    }
+
+    std::string path = test_directory + "/" + name;
+    FILE* file = fopen(path.c_str(), "wb");
+    CHECK(file);
+    CHECK(fwrite(data.data(), 1, data.size(), file) == data.size());
+    fclose(file);
+    return path;
+}
+
+bool bench_requested(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--bench"))
+            return true;
+    }
+    return false;
+}
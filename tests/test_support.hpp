@@ -0,0 +1,88 @@
+#ifndef TEST_SUPPORT_HPP
+#define TEST_SUPPORT_HPP
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+/// Fails the test program right away, the tests have no expected failures to keep going for.
+#define CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+/** Plain STREAMFILE over a copy of data that reports name as its file name,
+  * files opened through it get the same data. Not an ext streamfile, so
+  * peek_streamfile always fails on it and decoders take their read path.
+  */
+STREAMFILE* open_memory_streamfile(const std::vector<uint8_t>& data, const char* name);
+
+/// Number of read calls made on every memory streamfile so far.
+size_t memory_streamfile_reads(void);
+
+/** Writes data to a file named name in a directory private to the test
+  * program, removed when it exits. Returns the file's path, for open_ext_streamfile.
+  */
+std::string write_test_file(const char* name, const std::vector<uint8_t>& data);
+
+/// Deterministic generator so failures can be replayed, xorshift32.
+class test_random
+{
+public:
+    explicit test_random(uint32_t seed) : state(seed ? seed : 1) {}
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    /// Uniform in [0, bound), bound > 0.
+    uint32_t below(uint32_t bound) { return next() % bound; }
+
+    std::vector<uint8_t> bytes(size_t size)
+    {
+        std::vector<uint8_t> data(size);
+        for (auto& byte : data)
+            byte = next() >> 24;
+        return data;
+    }
+
+private:
+    uint32_t state;
+};
+
+/// True if the program was started with --bench, tests then also time what they checked.
+bool bench_requested(int argc, char** argv);
+
+/// Milliseconds function takes, best of runs so other processes don't skew it.
+template <typename F>
+double time_ms(F function, int runs = 5)
+{
+    double best = 0;
+    for (int i = 0; i < runs; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (i == 0 || elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best;
+}
+
+#endif
@@ -0,0 +1,1320 @@
+#include "vgmstream_reference.hpp"
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+extern "C"
+{
+    #include <clHCA.h>
+    #include <coding/coding.h>
+    #include <meta/meta.h>
+}
+
+bool reference_undefined = false;
+
+extern "C"
+{
+
+/* util.c */
+
+int check_sample_rate(int32_t sr)
+{
+    return !(sr < 1000 || sr > 96000);
+}
+
+const char * filename_extension(const char * filename)
+{
+    const char * ext;
+
+    ext = strrchr(filename, '.');
+    if (ext == NULL)
+        ext = filename + strlen(filename);
+    else
+        ext++;
+    return ext;
+}
+
+/* vgmstream.c, codec and layout data the tests don't create is left out */
+
+VGMSTREAM * allocate_vgmstream(int channel_count, int looped)
+{
+    VGMSTREAM * vgmstream;
+
+    if (channel_count <= 0) return NULL;
+
+    vgmstream = (VGMSTREAM *)calloc(1, sizeof(VGMSTREAM));
+    if (!vgmstream) return NULL;
+    vgmstream->ch = (VGMSTREAMCHANNEL *)calloc(channel_count, sizeof(VGMSTREAMCHANNEL));
+    vgmstream->start_ch = (VGMSTREAMCHANNEL *)calloc(channel_count, sizeof(VGMSTREAMCHANNEL));
+    vgmstream->start_vgmstream = calloc(1, sizeof(VGMSTREAM));
+    if (looped)
+        vgmstream->loop_ch = (VGMSTREAMCHANNEL *)calloc(channel_count, sizeof(VGMSTREAMCHANNEL));
+
+    vgmstream->channels = channel_count;
+    vgmstream->loop_flag = looped;
+    return vgmstream;
+}
+
+void close_vgmstream(VGMSTREAM * vgmstream)
+{
+    if (!vgmstream) return;
+
+    if (vgmstream->coding_type == coding_CRI_HCA)
+        free(vgmstream->codec_data);
+    free(vgmstream->ch);
+    free(vgmstream->start_ch);
+    free(vgmstream->loop_ch);
+    free(vgmstream->start_vgmstream);
+    free(vgmstream);
+}
+
+/* meta/bcstm.c, channel streamfiles aren't opened */
+
+VGMSTREAM * init_vgmstream_bcstm(STREAMFILE *streamFile) {
+    VGMSTREAM * vgmstream = NULL;
+    char filename[PATH_LIMIT];
+    coding_t coding_type;
+    off_t info_offset = 0, seek_offset = 0;
+    int info_found = 0, seek_found = 0;
+    int16_t temp_id;
+    int codec_number;
+    int channel_count;
+    int loop_flag;
+    int i;
+    int ima = 0;
+    int section_count;
+
+    streamFile->get_name(streamFile, filename, sizeof(filename));
+    if (strcasecmp("bcstm", filename_extension(filename)))
+        goto fail;
+
+    if ((uint32_t)read_32bitBE(0, streamFile) != 0x4353544D) /* "CSTM" */
+        goto fail;
+    if ((uint16_t)read_16bitLE(4, streamFile) != 0xFEFF)
+        goto fail;
+
+    section_count = read_16bitLE(0x10, streamFile);
+    for (i = 0; i < section_count; i++) {
+        temp_id = read_16bitLE(0x14 + i * 0xc, streamFile);
+        switch (temp_id) {
+            case 0x4000:
+                info_offset = read_32bitLE(0x18 + i * 0xc, streamFile);
+                info_found = 1;
+                break;
+            case 0x4001:
+                seek_offset = read_32bitLE(0x18 + i * 0xc, streamFile);
+                seek_found = 1;
+                break;
+            default:
+                break;
+        }
+    }
+    /* the library doesn't initialize the offsets */
+    if (!info_found) {
+        reference_undefined = true;
+        goto fail;
+    }
+
+    codec_number = read_8bit(info_offset + 0x20, streamFile);
+    loop_flag = read_8bit(info_offset + 0x21, streamFile);
+    channel_count = read_8bit(info_offset + 0x22, streamFile);
+
+    switch (codec_number) {
+        case 0:
+            coding_type = coding_PCM8;
+            break;
+        case 1:
+            coding_type = coding_PCM16LE;
+            break;
+        case 2:
+            if (!seek_found) {
+                reference_undefined = true;
+                goto fail;
+            }
+            if ((uint32_t)read_32bitBE(seek_offset, streamFile) != 0x5345454B) { /* "SEEK" */
+                coding_type = coding_INT_IMA;
+                ima = 1;
+            }
+            else
+                coding_type = coding_NGC_DSP;
+            break;
+        default:
+            goto fail;
+    }
+
+    if (channel_count < 1) goto fail;
+
+    vgmstream = allocate_vgmstream(channel_count, loop_flag);
+    if (!vgmstream) goto fail;
+
+    vgmstream->num_samples = read_32bitLE(info_offset + 0x2c, streamFile);
+    vgmstream->sample_rate = (uint16_t)read_16bitLE(info_offset + 0x24, streamFile);
+    vgmstream->loop_start_sample = read_32bitLE(info_offset + 0x28, streamFile);
+    vgmstream->loop_end_sample = vgmstream->num_samples;
+    if (ima && vgmstream->loop_start_sample > 10000) {
+        vgmstream->loop_start_sample -= 5000;
+        vgmstream->loop_end_sample = vgmstream->num_samples - 5000;
+    }
+
+    vgmstream->coding_type = coding_type;
+    if (channel_count == 1)
+        vgmstream->layout_type = layout_none;
+    else if (ima)
+        vgmstream->layout_type = layout_interleave;
+    else
+        vgmstream->layout_type = layout_interleave_shortblock;
+    vgmstream->meta_type = meta_CSTM;
+
+    return vgmstream;
+
+fail:
+    if (vgmstream) close_vgmstream(vgmstream);
+    return NULL;
+}
+
+/* meta/ahx.c, mpg123 isn't started */
+
+VGMSTREAM * init_vgmstream_ahx(STREAMFILE *streamFile) {
+    VGMSTREAM * vgmstream = NULL;
+    char filename[PATH_LIMIT];
+    off_t stream_offset;
+
+    streamFile->get_name(streamFile, filename, sizeof(filename));
+    if (strcasecmp("ahx", filename_extension(filename))) goto fail;
+
+    if ((uint16_t)read_16bitBE(0, streamFile) != 0x8000) goto fail;
+    stream_offset = (uint16_t)read_16bitBE(2, streamFile) + 4;
+    if ((uint16_t)read_16bitBE(stream_offset - 6, streamFile) != 0x2863 || /* "(c" */
+        (uint32_t)read_32bitBE(stream_offset - 4, streamFile) != 0x29435249) /* ")CRI" */
+        goto fail;
+
+    /* type, frame size, bits per sample, channels */
+    if (read_8bit(4, streamFile) != 0x11) goto fail;
+    if (read_8bit(5, streamFile) != 0) goto fail;
+    if (read_8bit(6, streamFile) != 0) goto fail;
+    if (read_8bit(7, streamFile) != 1) goto fail;
+
+    vgmstream = allocate_vgmstream(1, 0);
+    if (!vgmstream) goto fail;
+
+    vgmstream->num_samples = read_32bitBE(0xc, streamFile);
+    vgmstream->sample_rate = read_32bitBE(0x8, streamFile);
+    vgmstream->coding_type = coding_fake_MPEG2_L2;
+    vgmstream->layout_type = layout_fake_mpeg;
+    vgmstream->meta_type = meta_AHX;
+    return vgmstream;
+
+fail:
+    if (vgmstream) close_vgmstream(vgmstream);
+    return NULL;
+}
+
+/* meta/adx_header.c. The library is built with -ffast-math, its division of
+ * the filter coefficient by b comes out as a multiplication by 1/b. */
+
+struct adx_keys {
+    uint16_t start, mult, add;
+};
+
+static const struct adx_keys keys_8[] = {
+    {0x49e1,0x4a57,0x553d}, {0x5f5d,0x58bd,0x55ed}, {0x50fb,0x5803,0x5701}, {0x4f3f,0x472f,0x562f},
+    {0x66f5,0x58bd,0x4459}, {0x5deb,0x5f27,0x673f}, {0x46d3,0x5ced,0x474d}, {0x440b,0x6539,0x5723},
+    {0x586d,0x5d65,0x63eb}, {0x4969,0x5deb,0x467f}, {0x4d65,0x5eb7,0x5dfd}, {0x55b7,0x6191,0x5a77},
+    {0x5a17,0x509f,0x5bfd}, {0x4c01,0x549d,0x676f}, {0x5803,0x4555,0x47bf}, {0x59ed,0x4679,0x46c9},
+    {0x6157,0x6809,0x4045}, {0x45af,0x5f27,0x52b1}, {0x5f65,0x5b3d,0x5f65}, {0x5563,0x5047,0x43ed},
+    {0x4f7b,0x4fdb,0x5cbf}, {0x4f7b,0x5071,0x4c61}, {0x53e9,0x586d,0x4eaf}, {0x47e1,0x60e9,0x51c1},
+    {0x481d,0x4f25,0x5243}, {0x413b,0x543b,0x57d1}, {0x440d,0x4327,0x4fff}, {0x5f5d,0x552b,0x5507},
+    {0x645d,0x6011,0x5c29}, {0x62ad,0x4b13,0x5957}, {0x6305,0x509f,0x4c01}, {0x55b7,0x67e5,0x5387},
+    {0x6731,0x645d,0x566b}, {0x5fc5,0x63d9,0x599f}, {0x4c73,0x4d8d,0x5827}, {0x5a11,0x67e5,0x6751},
+    {0x5e75,0x4a89,0x4c61}, {0x64ab,0x5297,0x632f}, {0x4d82,0x5243,0x0685}, {0x54d1,0x526d,0x5e8b},
+    {0x4d06,0x663b,0x7d09}, {0x40a9,0x46b1,0x62ad}, {0x4601,0x671f,0x0455}, {0x41ef,0x463d,0x5507},
+    {0x4369,0x486d,0x5461}, {0x6809,0x5fd5,0x5bb1}, {0x5c33,0x4133,0x4ce7}, {0x4133,0x5a01,0x5723},
+};
+
+static const struct adx_keys keys_9[] = {
+    {0x07d2,0x1ec5,0x0c7f},
+    {0x0003,0x0d19,0x043b},
+};
+
+#define MAX_FRAMES (INT_MAX/0x8000)
+
+static int find_key(STREAMFILE *file, uint8_t type, uint16_t *xor_start, uint16_t *xor_mult, uint16_t *xor_add)
+{
+    uint16_t * scales = NULL;
+    uint16_t * prescales = NULL;
+    int bruteframe=0,bruteframecount=-1;
+    int startoff, endoff;
+    int rc = 0;
+
+    startoff=read_16bitBE(2, file)+4;
+    endoff=(read_32bitBE(12, file)+31)/32*18*read_8bit(7, file)+startoff;
+
+    /* how many scales? */
+    {
+        int framecount=(endoff-startoff)/18;
+        if (framecount<bruteframecount || bruteframecount<0)
+            bruteframecount=framecount;
+    }
+
+    /* find longest run of nonzero frames */
+    {
+        int longest=-1,longest_length=-1;
+        int i;
+        int length=0;
+        for (i=0;i<bruteframecount;i++) {
+            static const unsigned char zeroes[18]={0};
+            unsigned char buf[18];
+            /* a short read leaves whatever the stack held in buf */
+            if (read_streamfile(buf, startoff+i*18, 18, file) != 18) {
+                reference_undefined = true;
+                memset(buf, 0, sizeof(buf));
+            }
+            if (memcmp(zeroes,buf,18)) length++;
+            else length=0;
+            if (length > longest_length) {
+                longest_length=length;
+                longest=i-length+1;
+                if (longest_length >= 0x8000) break;
+            }
+        }
+        if (longest==-1) {
+            goto find_key_cleanup;
+        }
+        bruteframecount = longest_length;
+        bruteframe = longest;
+    }
+
+    {
+        /* try to guess key */
+        int scales_to_do;
+        int key_id;
+
+        /* allocate storage for scales */
+        scales_to_do = (bruteframecount > MAX_FRAMES ? MAX_FRAMES : bruteframecount);
+        scales = (uint16_t *)malloc(scales_to_do*sizeof(uint16_t));
+        if (!scales) {
+            goto find_key_cleanup;
+        }
+        /* prescales are those scales before the first frame we test
+         * against, we use these to compute the actual start */
+        if (bruteframe > 0) {
+            int i;
+            /* allocate memory for the prescales */
+            prescales = (uint16_t *)malloc(bruteframe*sizeof(uint16_t));
+            if (!prescales) {
+                goto find_key_cleanup;
+            }
+            /* read the prescales */
+            for (i=0; i<bruteframe; i++) {
+                prescales[i] = read_16bitBE(startoff+i*18, file);
+            }
+        }
+
+        /* read in the scales */
+        {
+            int i;
+            for (i=0; i < scales_to_do; i++) {
+                scales[i] = read_16bitBE(startoff+(bruteframe+i)*18, file);
+            }
+        }
+
+        if (type == 8)
+        {
+            /* guess each of the keys */
+            for (key_id=0;key_id<(int)(sizeof(keys_8)/sizeof(struct adx_keys));key_id++) {
+                /* test pre-scales */
+                uint16_t xor_key = keys_8[key_id].start;
+                uint16_t mult = keys_8[key_id].mult;
+                uint16_t add = keys_8[key_id].add;
+                int i;
+
+                for (i=0;i<bruteframe &&
+                        ((prescales[i]&0x6000)==(xor_key&0x6000) ||
+                         prescales[i]==0);
+                        i++) {
+                    xor_key = xor_key * mult + add;
+                }
+
+                if (i == bruteframe)
+                {
+                    /* test */
+                    for (i=0;i<scales_to_do &&
+                            (scales[i]&0x6000)==(xor_key&0x6000);i++) {
+                        xor_key = xor_key * mult + add;
+                    }
+                    if (i == scales_to_do)
+                    {
+                        *xor_start = keys_8[key_id].start;
+                        *xor_mult = keys_8[key_id].mult;
+                        *xor_add = keys_8[key_id].add;
+
+                        rc = 1;
+                        goto find_key_cleanup;
+                    }
+                }
+            }
+        }
+        else if (type == 9)
+        {
+            /* smarter XOR as seen in PSO2, can't do an exact match so we
+             * have to search for the lowest */
+            long best_score = MAX_FRAMES * 0x1fff;
+
+            for (key_id=0;key_id<(int)(sizeof(keys_9)/sizeof(struct adx_keys));key_id++) {
+                uint16_t xor_key = keys_9[key_id].start;
+                uint16_t mult = keys_9[key_id].mult;
+                uint16_t add = keys_9[key_id].add;
+                int i;
+                long total_score = 0;
+
+                for (i=0;i<bruteframe;i++) {
+                    xor_key = xor_key * mult + add;
+                }
+
+                if (i == bruteframe)
+                {
+                    /* test */
+                    for (i=0;i<scales_to_do && total_score < best_score;i++) {
+                        xor_key = xor_key * mult + add;
+                        total_score += (scales[i]^xor_key)&0x1fff;
+                    }
+
+                    if (total_score < best_score)
+                    {
+                        *xor_start = keys_9[key_id].start;
+                        *xor_mult = keys_9[key_id].mult;
+                        *xor_add = keys_9[key_id].add;
+                        best_score = total_score;
+                    }
+                }
+            }
+
+            /* arbitrarily decide if we have the right key */
+            if (best_score < scales_to_do*0x1000) rc = 1;
+        }
+    }
+
+find_key_cleanup:
+    if (scales) free(scales);
+    if (prescales) free(prescales);
+    return rc;
+}
+
+VGMSTREAM * init_vgmstream_adx(STREAMFILE *streamFile) {
+    VGMSTREAM * vgmstream = NULL;
+    /* off_t is 32 bits on the 3DS */
+    int32_t stream_offset;
+    uint16_t version_signature;
+    int loop_flag=0;
+    int channel_count;
+    int32_t loop_start_sample=0;
+    int32_t loop_end_sample=0;
+    meta_t header_type;
+    int16_t coef1, coef2;
+    uint16_t cutoff;
+    char filename[PATH_LIMIT];
+    coding_t coding_type = coding_CRI_ADX;
+    uint16_t xor_start=0,xor_mult=0,xor_add=0;
+
+    /* check extension, case insensitive */
+    streamFile->get_name(streamFile,filename,sizeof(filename));
+    if (strcasecmp("adx",filename_extension(filename))) goto fail;
+
+    /* check first 2 bytes */
+    if ((uint16_t)read_16bitBE(0,streamFile)!=0x8000) goto fail;
+
+    /* get stream offset, check for CRI signature just before */
+    stream_offset = (uint16_t)read_16bitBE(2,streamFile) + 4;
+    if ((uint16_t)read_16bitBE(stream_offset-6,streamFile)!=0x2863 ||/* "(c" */
+        (uint32_t)read_32bitBE(stream_offset-4,streamFile)!=0x29435249 /* ")CRI" */
+       ) goto fail;
+
+    /* check for encoding type */
+    if (read_8bit(4,streamFile) != 3) goto fail;
+
+    /* check for frame size (only 18 is supported at the moment) */
+    if (read_8bit(5,streamFile) != 18) goto fail;
+
+    /* check for bits per sample? (only 4 makes sense for ADX) */
+    if (read_8bit(6,streamFile) != 4) goto fail;
+
+    /* check version signature, read loop info */
+    version_signature = read_16bitBE(0x12,streamFile);
+    /* encryption */
+    if (version_signature == 0x0408) {
+        if (find_key(streamFile, 8, &xor_start, &xor_mult, &xor_add))
+        {
+            coding_type = coding_CRI_ADX_enc_8;
+            version_signature = 0x0400;
+        }
+        else goto fail;
+    }
+    else if (version_signature == 0x0409) {
+        if (find_key(streamFile, 9, &xor_start, &xor_mult, &xor_add))
+        {
+            coding_type = coding_CRI_ADX_enc_9;
+            version_signature = 0x0400;
+        }
+        else goto fail;
+    }
+
+    if (version_signature == 0x0300) {  /* type 03 */
+        header_type = meta_ADX_03;
+        if (stream_offset-6 >= 0x2c) {   /* enough space for loop info? */
+            loop_flag = (read_32bitBE(0x18,streamFile) != 0);
+            loop_start_sample = read_32bitBE(0x1c,streamFile);
+            loop_end_sample = read_32bitBE(0x24,streamFile);
+        }
+    } else if (version_signature == 0x0400) {
+        int32_t ainf_info_length=0;
+        if ((uint32_t)read_32bitBE(0x24,streamFile)==0x41494E46) /* AINF Header */
+            ainf_info_length = read_32bitBE(0x28,streamFile);
+
+        header_type = meta_ADX_04;
+        if (stream_offset-ainf_info_length-6 >= 0x38) {   /* enough space for loop info? */
+            if ((uint32_t)read_32bitBE(0x24,streamFile) == 0xFFFEFFFE)
+                loop_flag = 0;
+            else
+                loop_flag = (read_32bitBE(0x24,streamFile) != 0);
+
+            loop_start_sample = read_32bitBE(0x28,streamFile);
+            loop_end_sample = read_32bitBE(0x30,streamFile);
+        }
+    } else if (version_signature == 0x0500) {  /* found in some SFD : Buggy Heat, appears to have no looping */
+        header_type = meta_ADX_05;
+    } else goto fail;                  /* not a known/supported version signature */
+
+    /* high-pass cutoff frequency, always 500 that I've seen */
+    cutoff = (uint16_t)read_16bitBE(0x10,streamFile);
+
+    if (loop_start_sample == 0 && loop_end_sample == 0) {
+        loop_flag = 0;
+    }
+
+    channel_count = read_8bit(7,streamFile);
+    vgmstream = allocate_vgmstream(channel_count,loop_flag);
+    if (!vgmstream) goto fail;
+
+    vgmstream->num_samples = read_32bitBE(0xc,streamFile);
+    vgmstream->sample_rate = read_32bitBE(8,streamFile);
+    vgmstream->loop_start_sample = loop_start_sample;
+    vgmstream->loop_end_sample = loop_end_sample;
+
+    vgmstream->coding_type = coding_type;
+    if (channel_count==1)
+        vgmstream->layout_type = layout_none;
+    else
+        vgmstream->layout_type = layout_interleave;
+    vgmstream->meta_type = header_type;
+
+    vgmstream->interleave_block_size=18;
+
+    /* calculate filter coefficients */
+    {
+        double x,y,z,a,b,c;
+
+        x = cutoff;
+        y = vgmstream->sample_rate;
+        z = cos(2.0*M_PI*x/y);
+
+        a = M_SQRT2-z;
+        b = M_SQRT2-1.0;
+        c = (a-sqrt((a+b)*(a-b)))*(1.0/b);
+        /* a 0 Hz sample rate, converting floor(NaN) to int is undefined */
+        if (c != c) reference_undefined = true;
+
+        coef1 = (int)floor(c*8192);
+        coef2 = (int)floor(c*c*-4096);
+    }
+
+    {
+        int i;
+        STREAMFILE * chstreamfile;
+
+        /* ADX is so tightly interleaved that having a separate buffer
+         * for each channel actually hurts performance */
+        chstreamfile = streamFile->open(streamFile,filename,18*0x400);
+        if (!chstreamfile) goto fail;
+
+        for (i=0;i<channel_count;i++) {
+            vgmstream->ch[i].streamfile = chstreamfile;
+
+            vgmstream->ch[i].channel_start_offset=
+                vgmstream->ch[i].offset=
+                stream_offset+18*i;
+
+            vgmstream->ch[i].adpcm_coef[0] = coef1;
+            vgmstream->ch[i].adpcm_coef[1] = coef2;
+
+            if (coding_type == coding_CRI_ADX_enc_8 ||
+                coding_type == coding_CRI_ADX_enc_9)
+            {
+                int j;
+                vgmstream->ch[i].adx_channels = channel_count;
+                vgmstream->ch[i].adx_xor = xor_start;
+                vgmstream->ch[i].adx_mult = xor_mult;
+                vgmstream->ch[i].adx_add = xor_add;
+
+                for (j=0;j<i;j++)
+                    adx_next_key(&vgmstream->ch[i]);
+            }
+        }
+    }
+
+    return vgmstream;
+
+fail:
+    if (vgmstream) close_vgmstream(vgmstream);
+    return NULL;
+}
+
+/* clHCA.c, the header part of clHCA_Decode */
+
+typedef struct {
+    const uint8_t *data;
+    int size;
+    int bit;
+} clData;
+
+static unsigned int clData_CheckBit(clData *d, int bitSize) {
+    unsigned int v = 0;
+    int i;
+    if (d->bit + bitSize > d->size) return 0;
+    for (i = 0; i < bitSize; i++) {
+        int bit = d->bit + i;
+        v = (v << 1) | ((d->data[bit >> 3] >> (7 - (bit & 7))) & 1);
+    }
+    return v;
+}
+
+static unsigned int clData_GetBit(clData *d, int bitSize) {
+    unsigned int v = clData_CheckBit(d, bitSize);
+    d->bit += bitSize;
+    return v;
+}
+
+static unsigned short clHCA_CheckSum(const uint8_t *data, int size) {
+    unsigned short sum = 0;
+    int i, j;
+    for (i = 0; i < size; i++) {
+        /* CRC-16 with polynomial 0x8005, the library looks the table up */
+        sum ^= data[i] << 8;
+        for (j = 0; j < 8; j++)
+            sum = (sum & 0x8000) ? (sum << 1) ^ 0x8005 : sum << 1;
+    }
+    return sum;
+}
+
+int clHCA_isOurFile0(const void *data) {
+    clData d = {(const uint8_t *)data, 8 * 8, 0};
+    if ((clData_CheckBit(&d, 32) & 0x7F7F7F7F) != 0x48434100) /* "HCA\0" */
+        return -1;
+    d.bit = 48;
+    return clData_CheckBit(&d, 16);
+}
+
+int clHCA_isOurFile1(const void *data, unsigned int size) {
+    int minsize;
+    if (size < 0x08) return -1;
+    minsize = clHCA_isOurFile0(data);
+    if (minsize < 0 || (unsigned int)minsize > size) return -1;
+    if (clHCA_CheckSum((const uint8_t *)data, minsize)) return -1;
+    return 0;
+}
+
+struct hca_header {
+    unsigned int version, channelCount, samplingRate, blockCount;
+    unsigned int loopFlg, loopStart, loopEnd;
+};
+
+/* what clHCA_Decode checks on the header and clHCA_getInfo hands back */
+static int hca_decode_header(const uint8_t *data, unsigned int size, struct hca_header *h) {
+    clData d = {data, (int)size * 8, 0};
+    unsigned int dataOffset, blockSize, r01, r02, vbr_r01, ath_type, ciph_type, comm_len;
+
+    if (size < 8) return -1;
+    if ((clData_GetBit(&d, 32) & 0x7F7F7F7F) != 0x48434100) return -1; /* "HCA\0" */
+    h->version = clData_GetBit(&d, 16);
+    dataOffset = clData_GetBit(&d, 16);
+    if (size < dataOffset) return -1;
+    size -= 8;
+
+    if (size < 16) return -1;
+    if ((clData_GetBit(&d, 32) & 0x7F7F7F7F) != 0x666D7400) return -1; /* "fmt\0" */
+    h->channelCount = clData_GetBit(&d, 8);
+    h->samplingRate = clData_GetBit(&d, 24);
+    h->blockCount = clData_GetBit(&d, 32);
+    clData_GetBit(&d, 16); /* muteHeader */
+    clData_GetBit(&d, 16); /* muteFooter */
+    if (h->channelCount < 1 || h->channelCount > 16) return -1;
+    if (h->samplingRate < 1 || h->samplingRate > 0x7FFFFF) return -1;
+    size -= 16;
+
+    if (size >= 16 && (clData_CheckBit(&d, 32) & 0x7F7F7F7F) == 0x636F6D70) { /* "comp" */
+        d.bit += 32;
+        blockSize = clData_GetBit(&d, 16);
+        r01 = clData_GetBit(&d, 8);
+        r02 = clData_GetBit(&d, 8);
+        d.bit += 8 * 8; /* r03 to r08 and reserved */
+        if (!(r01 <= r02 && r02 <= 0x1F)) return -1;
+        if (blockSize != 0 && (blockSize < 8 || blockSize > 0xFFFF)) return -1;
+        size -= 16;
+    }
+    else if (size >= 12 && (clData_CheckBit(&d, 32) & 0x7F7F7F7F) == 0x64656300) { /* "dec\0" */
+        d.bit += 32;
+        blockSize = clData_GetBit(&d, 16);
+        r01 = clData_GetBit(&d, 8);
+        r02 = clData_GetBit(&d, 8);
+        d.bit += 8 + 8 + 4 + 4 + 8; /* count1, count2, r03, r04, enableCount2 */
+        if (!(r01 <= r02 && r02 <= 0x1F)) return -1;
+        if (blockSize != 0 && (blockSize < 8 || blockSize > 0xFFFF)) return -1;
+        size -= 12;
+    }
+    else
+        return -1;
+
+    /* neither vbr nor ath count towards size */
+    if (size >= 8 && (clData_CheckBit(&d, 32) & 0x7F7F7F7F) == 0x76627200) { /* "vbr\0" */
+        d.bit += 32;
+        vbr_r01 = clData_GetBit(&d, 16);
+        clData_GetBit(&d, 16);
+        if (!(blockSize == 0 && vbr_r01 < 0x200)) return -1;
+    }
+
+    if (size >= 6 && (clData_CheckBit(&d, 32) & 0x7F7F7F7F) == 0x61746800) { /* "ath\0" */
+        d.bit += 32;
+        ath_type = clData_GetBit(&d, 16);
+    }
+    else
+        ath_type = (h->version < 0x200) ? 1 : 0;
+
+    if (size >= 16 && (clData_CheckBit(&d, 32) & 0x7F7F7F7F) == 0x6C6F6F70) { /* "loop" */
+        d.bit += 32;
+        h->loopStart = clData_GetBit(&d, 32);
+        h->loopEnd = clData_GetBit(&d, 32);
+        clData_GetBit(&d, 16); /* loopCount */
+        clData_GetBit(&d, 16); /* loop_r01 */
+        h->loopFlg = 1;
+        if (!(h->loopStart <= h->loopEnd && h->loopEnd < h->blockCount)) return -1;
+        size -= 16;
+    }
+    else {
+        h->loopStart = 0;
+        h->loopEnd = 0;
+        h->loopFlg = 0;
+    }
+
+    if (size >= 6 && (clData_CheckBit(&d, 32) & 0x7F7F7F7F) == 0x63697068) { /* "ciph" */
+        d.bit += 32;
+        ciph_type = clData_GetBit(&d, 16);
+        if (!(ciph_type == 0 || ciph_type == 1 || ciph_type == 0x38)) return -1;
+        size -= 6;
+    }
+
+    if (size >= 8 && (clData_CheckBit(&d, 32) & 0x7F7F7F7F) == 0x72766100) { /* "rva\0" */
+        d.bit += 32;
+        clData_GetBit(&d, 32); /* volume */
+        size -= 8;
+    }
+
+    if (size >= 5 && (clData_CheckBit(&d, 32) & 0x7F7F7F7F) == 0x636F6D6D) { /* "comm" */
+        d.bit += 32;
+        comm_len = clData_GetBit(&d, 8);
+        if (comm_len > size) return -1;
+    }
+
+    /* _ath.Init */
+    if (!(ath_type == 0 || ath_type == 1)) return -1;
+    if (!(r01 == 1 && r02 == 15)) return -1;
+    return 0;
+}
+
+/* meta/hca.c, the decoder state is left out */
+
+VGMSTREAM * init_vgmstream_hca(STREAMFILE *streamFile) {
+    VGMSTREAM * vgmstream = NULL;
+    unsigned char buffer[8];
+    unsigned char *header = NULL;
+    int header_size;
+    struct hca_header h;
+
+    if (get_streamfile_size(streamFile) < 8) goto fail;
+    if (read_streamfile(buffer, 0, 8, streamFile) != 8) goto fail;
+    header_size = clHCA_isOurFile0(buffer);
+    if (header_size < 0) goto fail;
+    /* the library copies the 8 bytes read into a smaller allocation */
+    if (header_size < 8) {
+        reference_undefined = true;
+        goto fail;
+    }
+
+    header = (unsigned char *)malloc(header_size);
+    if (!header) goto fail;
+    memcpy(header, buffer, 8);
+    if (read_streamfile(header + 8, 8, header_size - 8, streamFile) != (size_t)(header_size - 8)) goto fail;
+    if (clHCA_isOurFile1(header, header_size) < 0) goto fail;
+    if (hca_decode_header(header, header_size, &h) < 0) goto fail;
+    free(header);
+    header = NULL;
+
+    vgmstream = allocate_vgmstream(h.channelCount, 1);
+    if (!vgmstream) goto fail;
+
+    vgmstream->loop_flag = h.loopFlg;
+    vgmstream->channels = h.channelCount;
+    vgmstream->sample_rate = h.samplingRate;
+    vgmstream->num_samples = h.blockCount * clHCA_samplesPerBlock;
+    vgmstream->loop_start_sample = h.loopStart * clHCA_samplesPerBlock;
+    vgmstream->loop_end_sample = h.loopEnd * clHCA_samplesPerBlock;
+    vgmstream->coding_type = coding_CRI_HCA;
+    vgmstream->layout_type = layout_none;
+    vgmstream->meta_type = meta_HCA;
+    return vgmstream;
+
+fail:
+    free(header);
+    return NULL;
+}
+
+/* coding/ngc_dsp_decoder.c */
+
+void decode_ngc_dsp(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    int i=first_sample;
+    int32_t sample_count;
+
+    int framesin = first_sample/14;
+
+    int8_t header = read_8bit(framesin*8+stream->offset,stream->streamfile);
+    int32_t scale = 1 << (header & 0xf);
+    int coef_index = (header >> 4) & 0xf;
+    int32_t hist1 = stream->adpcm_history1_16;
+    int32_t hist2 = stream->adpcm_history2_16;
+    int coef1 = stream->adpcm_coef[coef_index*2];
+    int coef2 = stream->adpcm_coef[coef_index*2+1];
+
+    first_sample = first_sample%14;
+
+    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
+        int sample_byte = read_8bit(framesin*8+stream->offset+1+i/2,stream->streamfile);
+
+        outbuf[sample_count] = clamp16((
+                 (((i&1?
+                    get_low_nibble_signed(sample_byte):
+                    get_high_nibble_signed(sample_byte)
+                   ) * scale)<<11) + 1024 +
+                 (coef1 * hist1 + coef2 * hist2))>>11
+                );
+
+        hist2 = hist1;
+        hist1 = outbuf[sample_count];
+    }
+
+    stream->adpcm_history1_16 = hist1;
+    stream->adpcm_history2_16 = hist2;
+}
+
+/* coding/adx_decoder.c */
+
+void decode_adx(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    int i;
+    int32_t sample_count;
+
+    int framesin = first_sample/32;
+
+    int32_t scale = read_16bitBE(stream->offset+framesin*18,stream->streamfile) + 1;
+    int32_t hist1 = stream->adpcm_history1_32;
+    int32_t hist2 = stream->adpcm_history2_32;
+    int coef1 = stream->adpcm_coef[0];
+    int coef2 = stream->adpcm_coef[1];
+
+    first_sample = first_sample%32;
+
+    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
+        int sample_byte = read_8bit(stream->offset+framesin*18+2+i/2,stream->streamfile);
+
+        outbuf[sample_count] = clamp16(
+                (i&1?
+                 get_low_nibble_signed(sample_byte):
+                 get_high_nibble_signed(sample_byte)
+                ) * scale +
+                ((coef1 * hist1 + coef2 * hist2) >> 12)
+                );
+
+        hist2 = hist1;
+        hist1 = outbuf[sample_count];
+    }
+
+    stream->adpcm_history1_32 = hist1;
+    stream->adpcm_history2_32 = hist2;
+}
+
+void adx_next_key(VGMSTREAMCHANNEL * stream)
+{
+    stream->adx_xor = ( stream->adx_xor * stream->adx_mult + stream->adx_add ) & 0x7fff;
+}
+
+void decode_adx_enc(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    int i;
+    int32_t sample_count;
+
+    int framesin = first_sample/32;
+
+    int32_t scale = ((read_16bitBE(stream->offset+framesin*18,stream->streamfile) ^ stream->adx_xor)&0x1fff) + 1;
+    int32_t hist1 = stream->adpcm_history1_32;
+    int32_t hist2 = stream->adpcm_history2_32;
+    int coef1 = stream->adpcm_coef[0];
+    int coef2 = stream->adpcm_coef[1];
+
+    first_sample = first_sample%32;
+
+    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
+        int sample_byte = read_8bit(stream->offset+framesin*18+2+i/2,stream->streamfile);
+
+        outbuf[sample_count] = clamp16(
+                (i&1?
+                 get_low_nibble_signed(sample_byte):
+                 get_high_nibble_signed(sample_byte)
+                ) * scale +
+                ((coef1 * hist1 + coef2 * hist2) >> 12)
+                );
+
+        hist2 = hist1;
+        hist1 = outbuf[sample_count];
+    }
+
+    stream->adpcm_history1_32 = hist1;
+    stream->adpcm_history2_32 = hist2;
+
+    if (!(i % 32)) {
+        for (i=0;i<stream->adx_channels;i++)
+        {
+            adx_next_key(stream);
+        }
+    }
+}
+
+/* coding/pcm_decoder.c */
+
+void decode_pcm16LE(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    int i;
+    int32_t sample_count;
+
+    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
+        outbuf[sample_count]=read_16bitLE(stream->offset+i*2,stream->streamfile);
+    }
+}
+
+void decode_pcm16BE(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    int i;
+    int32_t sample_count;
+
+    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
+        outbuf[sample_count]=read_16bitBE(stream->offset+i*2,stream->streamfile);
+    }
+}
+
+void decode_pcm8(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    int i;
+    int32_t sample_count;
+
+    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
+        outbuf[sample_count]=read_8bit(stream->offset+i,stream->streamfile)*0x100;
+    }
+}
+
+/* coding/hca_decoder.c, samples_remain cast where C's -Wall left the signed/unsigned comparisons alone */
+
+void decode_hca(hca_codec_data * data, sample * outbuf, int32_t samples_to_do, int channels) {
+    int samples_done = 0;
+    int32_t samples_remain = clHCA_samplesPerBlock - data->sample_ptr;
+    void *hca_data = NULL;
+    clHCA *hca;
+
+    if ( data->samples_discard ) {
+        if ( (uint32_t)samples_remain <= data->samples_discard ) {
+            data->samples_discard -= samples_remain;
+            samples_remain = 0;
+        }
+        else {
+            samples_remain -= data->samples_discard;
+            data->sample_ptr += data->samples_discard;
+            data->samples_discard = 0;
+        }
+    }
+
+    if ( samples_remain > samples_to_do ) samples_remain = samples_to_do;
+
+    memcpy( outbuf, data->sample_buffer + data->sample_ptr * data->info.channelCount, samples_remain * data->info.channelCount * sizeof(sample) );
+
+    outbuf += samples_remain * data->info.channelCount;
+
+    data->sample_ptr += samples_remain;
+
+    samples_done += samples_remain;
+
+    hca_data = malloc( data->info.blockSize );
+
+    if ( !hca_data ) return;
+
+    hca = (clHCA *)(data + 1);
+
+    while ( samples_done < samples_to_do ) {
+        const unsigned int blockSize = data->info.blockSize;
+        const unsigned int channelCount = data->info.channelCount;
+        const unsigned int address = data->info.dataOffset + data->curblock * blockSize;
+
+        if (data->curblock >= data->info.blockCount) {
+            memset(outbuf, 0, (samples_to_do - samples_done) * channelCount * sizeof(sample));
+            break;
+        }
+
+        if ( read_streamfile((uint8_t*) hca_data, data->start + address, blockSize, data->streamfile) != blockSize )
+            break;
+
+        if ( clHCA_Decode( hca, hca_data, blockSize, address ) < 0 )
+            break;
+
+        ++data->curblock;
+
+        clHCA_DecodeSamples16( hca, data->sample_buffer );
+
+        samples_remain = clHCA_samplesPerBlock;
+        data->sample_ptr = 0;
+        if ( data->samples_discard ) {
+            if ( (uint32_t)samples_remain <= data->samples_discard ) {
+                data->samples_discard -= samples_remain;
+                samples_remain = 0;
+            }
+            else {
+                samples_remain -= data->samples_discard;
+                data->sample_ptr = data->samples_discard;
+                data->samples_discard = 0;
+            }
+        }
+
+        if ( samples_remain > samples_to_do - samples_done ) samples_remain = samples_to_do - samples_done;
+        memcpy( outbuf, data->sample_buffer, samples_remain * channelCount * sizeof(sample) );
+        samples_done += samples_remain;
+        outbuf += samples_remain * channelCount;
+        data->sample_ptr = samples_remain;
+    }
+
+    free( hca_data );
+}
+
+/* coding/g721_decoder.c, Sun's reference G.721 code. The library computes
+   a2p before the tr branch, update() below does the same. */
+
+static short power2[15] = {1, 2, 4, 8, 0x10, 0x20, 0x40, 0x80,
+            0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000};
+
+static int quan(int val, short *table, int size)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+        if (val < *table++)
+            break;
+    return (i);
+}
+
+static int fmult(int an, int srn)
+{
+    short anmag, anexp, anmant;
+    short wanexp, wanmant;
+    short retval;
+
+    anmag = (an > 0) ? an : ((-an) & 0x1FFF);
+    anexp = quan(anmag, power2, 15) - 6;
+    anmant = (anmag == 0) ? 32 :
+        (anexp >= 0) ? anmag >> anexp : anmag << -anexp;
+    wanexp = anexp + ((srn >> 6) & 0xF) - 13;
+
+    wanmant = (anmant * (srn & 077) + 0x30) >> 4;
+    retval = (wanexp >= 0) ? ((wanmant << wanexp) & 0x7FFF) :
+        (wanmant >> -wanexp);
+
+    return (((an ^ srn) < 0) ? -retval : retval);
+}
+
+void g72x_init_state(struct g72x_state *state_ptr)
+{
+    int cnta;
+
+    state_ptr->yl = 34816;
+    state_ptr->yu = 544;
+    state_ptr->dms = 0;
+    state_ptr->dml = 0;
+    state_ptr->ap = 0;
+    for (cnta = 0; cnta < 2; cnta++) {
+        state_ptr->a[cnta] = 0;
+        state_ptr->pk[cnta] = 0;
+        state_ptr->sr[cnta] = 32;
+    }
+    for (cnta = 0; cnta < 6; cnta++) {
+        state_ptr->b[cnta] = 0;
+        state_ptr->dq[cnta] = 32;
+    }
+    state_ptr->td = 0;
+}
+
+static int predictor_zero(struct g72x_state *state_ptr)
+{
+    int i;
+    int sezi;
+
+    sezi = fmult(state_ptr->b[0] >> 2, state_ptr->dq[0]);
+    for (i = 1; i < 6; i++)
+        sezi += fmult(state_ptr->b[i] >> 2, state_ptr->dq[i]);
+    return (sezi);
+}
+
+static int predictor_pole(struct g72x_state *state_ptr)
+{
+    return (fmult(state_ptr->a[1] >> 2, state_ptr->sr[1]) +
+        fmult(state_ptr->a[0] >> 2, state_ptr->sr[0]));
+}
+
+static int step_size(struct g72x_state *state_ptr)
+{
+    int y;
+    int dif;
+    int al;
+
+    if (state_ptr->ap >= 256)
+        return (state_ptr->yu);
+    else {
+        y = state_ptr->yl >> 6;
+        dif = state_ptr->yu - y;
+        al = state_ptr->ap >> 2;
+        if (dif > 0)
+            y += (dif * al) >> 6;
+        else if (dif < 0)
+            y += (dif * al + 0x3F) >> 6;
+        return (y);
+    }
+}
+
+static int reconstruct(int sign, int dqln, int y)
+{
+    short dql;
+    short dex;
+    short dqt;
+    short dq;
+
+    dql = dqln + (y >> 2);
+
+    if (dql < 0) {
+        return ((sign) ? -0x8000 : 0);
+    } else {
+        dex = (dql >> 7) & 15;
+        dqt = 128 + (dql & 127);
+        dq = (dqt << 7) >> (14 - dex);
+        return ((sign) ? (dq - 0x8000) : dq);
+    }
+}
+
+static void update(int code_size, int y, int wi, int fi, int dq, int sr, int dqsez, struct g72x_state *state_ptr)
+{
+    int cnt;
+    short mag, exp;
+    short a2p;
+    short a1ul;
+    short pks1;
+    short fa1;
+    char tr;
+    short ylint, thr1, ylfrac, thr2, dqthr;
+    short pk0;
+
+    pk0 = (dqsez < 0) ? 1 : 0;
+
+    mag = dq & 0x7FFF;
+
+    ylint = state_ptr->yl >> 15;
+    ylfrac = (state_ptr->yl >> 10) & 0x1F;
+    thr1 = (32 + ylfrac) << ylint;
+    thr2 = (ylint > 9) ? 31 << 10 : thr1;
+    dqthr = (thr2 + (thr2 >> 1)) >> 1;
+    if (state_ptr->td == 0)
+        tr = 0;
+    else if (mag <= dqthr)
+        tr = 0;
+    else
+        tr = 1;
+
+    state_ptr->yu = y + ((wi - y) >> 5);
+
+    if (state_ptr->yu < 544)
+        state_ptr->yu = 544;
+    else if (state_ptr->yu > 5120)
+        state_ptr->yu = 5120;
+
+    state_ptr->yl += state_ptr->yu + ((-state_ptr->yl) >> 6);
+
+    a2p = state_ptr->a[1] - (state_ptr->a[1] >> 7);
+    if (tr == 1) {
+        state_ptr->a[0] = 0;
+        state_ptr->a[1] = 0;
+        state_ptr->b[0] = 0;
+        state_ptr->b[1] = 0;
+        state_ptr->b[2] = 0;
+        state_ptr->b[3] = 0;
+        state_ptr->b[4] = 0;
+        state_ptr->b[5] = 0;
+    } else {
+        pks1 = pk0 ^ state_ptr->pk[0];
+
+        if (dqsez != 0) {
+            fa1 = (pks1) ? state_ptr->a[0] : -state_ptr->a[0];
+            if (fa1 < -8191)
+                a2p -= 0x100;
+            else if (fa1 > 8191)
+                a2p += 0xFF;
+            else
+                a2p += fa1 >> 5;
+
+            if (pk0 ^ state_ptr->pk[1])
+                if (a2p <= -12160)
+                    a2p = -12288;
+                else if (a2p >= 12416)
+                    a2p = 12288;
+                else
+                    a2p -= 0x80;
+            else if (a2p <= -12416)
+                a2p = -12288;
+            else if (a2p >= 12160)
+                a2p = 12288;
+            else
+                a2p += 0x80;
+        }
+
+        state_ptr->a[1] = a2p;
+
+        state_ptr->a[0] -= state_ptr->a[0] >> 8;
+        if (dqsez != 0) {
+            if (pks1 == 0)
+                state_ptr->a[0] += 192;
+            else
+                state_ptr->a[0] -= 192;
+        }
+
+        a1ul = 15360 - a2p;
+        if (state_ptr->a[0] < -a1ul)
+            state_ptr->a[0] = -a1ul;
+        else if (state_ptr->a[0] > a1ul)
+            state_ptr->a[0] = a1ul;
+
+        for (cnt = 0; cnt < 6; cnt++) {
+            if (code_size == 5)
+                state_ptr->b[cnt] -= state_ptr->b[cnt] >> 9;
+            else
+                state_ptr->b[cnt] -= state_ptr->b[cnt] >> 8;
+            if (dq & 0x7FFF) {
+                if ((dq ^ state_ptr->dq[cnt]) >= 0)
+                    state_ptr->b[cnt] += 128;
+                else
+                    state_ptr->b[cnt] -= 128;
+            }
+        }
+    }
+
+    for (cnt = 5; cnt > 0; cnt--)
+        state_ptr->dq[cnt] = state_ptr->dq[cnt-1];
+    if (mag == 0) {
+        state_ptr->dq[0] = (dq >= 0) ? 0x20 : 0xFC20;
+    } else {
+        exp = quan(mag, power2, 15);
+        state_ptr->dq[0] = (dq >= 0) ?
+            (exp << 6) + ((mag << 6) >> exp) :
+            (exp << 6) + ((mag << 6) >> exp) - 0x400;
+    }
+
+    state_ptr->sr[1] = state_ptr->sr[0];
+    if (sr == 0) {
+        state_ptr->sr[0] = 0x20;
+    } else if (sr > 0) {
+        exp = quan(sr, power2, 15);
+        state_ptr->sr[0] = (exp << 6) + ((sr << 6) >> exp);
+    } else if (sr > -32768) {
+        mag = -sr;
+        exp = quan(mag, power2, 15);
+        state_ptr->sr[0] = (exp << 6) + ((mag << 6) >> exp) - 0x400;
+    } else
+        state_ptr->sr[0] = 0xFC20;
+
+    state_ptr->pk[1] = state_ptr->pk[0];
+    state_ptr->pk[0] = pk0;
+
+    if (tr == 1)
+        state_ptr->td = 0;
+    else if (a2p < -11776)
+        state_ptr->td = 1;
+    else
+        state_ptr->td = 0;
+
+    state_ptr->dms += (fi - state_ptr->dms) >> 5;
+    state_ptr->dml += (((fi << 2) - state_ptr->dml) >> 7);
+
+    if (tr == 1)
+        state_ptr->ap = 256;
+    else if (y < 1536)
+        state_ptr->ap += (0x200 - state_ptr->ap) >> 4;
+    else if (state_ptr->td == 1)
+        state_ptr->ap += (0x200 - state_ptr->ap) >> 4;
+    else if (abs((state_ptr->dms << 2) - state_ptr->dml) >=
+        (state_ptr->dml >> 3))
+        state_ptr->ap += (0x200 - state_ptr->ap) >> 4;
+    else
+        state_ptr->ap += (-state_ptr->ap) >> 4;
+}
+
+static short _dqlntab[16] = {-2048, 4, 135, 213, 273, 323, 373, 425,
+                425, 373, 323, 273, 213, 135, 4, -2048};
+static short _witab[16] = {-12, 18, 41, 64, 112, 198, 355, 1122,
+                1122, 355, 198, 112, 64, 41, 18, -12};
+static short _fitab[16] = {0, 0, 0, 0x200, 0x200, 0x200, 0x600, 0xE00,
+                0xE00, 0x600, 0x200, 0x200, 0x200, 0, 0, 0};
+
+static int g721_decoder(int i, struct g72x_state *state_ptr)
+{
+    short sezi, sei, sez, se;
+    short y;
+    short sr;
+    short dq;
+    short dqsez;
+
+    i &= 0x0f;
+    sezi = predictor_zero(state_ptr);
+    sez = sezi >> 1;
+    sei = sezi + predictor_pole(state_ptr);
+    se = sei >> 1;
+
+    y = step_size(state_ptr);
+    dq = reconstruct(i & 0x08, _dqlntab[i], y);
+
+    sr = (dq < 0) ? (se - (dq & 0x3FFF)) : se + dq;
+
+    dqsez = sr - se + sez;
+
+    update(4, y, _witab[i] << 5, _fitab[i], dq, sr, dqsez, state_ptr);
+
+    return (sr << 2);
+}
+
+void decode_g721(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    int i;
+    int32_t sample_count;
+
+    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
+        outbuf[sample_count]=
+            g721_decoder(
+                read_8bit(stream->offset+i/2,stream->streamfile)>>(i&1?4:0),
+                &(stream->g72x_state)
+            );
+    }
+}
+
+}
@@ -0,0 +1,24 @@
+#ifndef VGMSTREAM_REFERENCE_HPP
+#define VGMSTREAM_REFERENCE_HPP
+
+/** libvgmstream is only built for the 3DS, vgmstream_reference.cpp holds
+  * transcriptions of the library functions the tests run the player code
+  * against. They are defined under the library's own names, so the player
+  * code links against them as it would against libvgmstream.
+  */
+
+extern "C"
+{
+    #include <vgmstream.h>
+}
+
+/** Set by a reference meta that hit a path the library leaves undefined
+  * (an uninitialized offset it goes on to read from), whatever it returned
+  * then says nothing about the library. Cleared by the caller.
+  */
+extern bool reference_undefined;
+
+/// Not declared by the library's headers, decode_vgmstream calls it for coding_CRI_HCA.
+extern "C" void decode_hca(hca_codec_data* data, sample* outbuf, int32_t samples_to_do, int channels);
+
+#endif
@@ -0,0 +1,39 @@
+/** Library functions the linked player code references but no test calls.
+  * They're weak so the transcriptions in vgmstream_reference.cpp take their
+  * place, calling one that wasn't transcribed stops the test.
+  * The library headers aren't included, their prototypes would clash.
+  */
+
+#include <cstdio>
+#include <cstdlib>
+
+static void missing(const char* name)
+{
+    fprintf(stderr, "%s is not in vgmstream_reference.cpp\n", name);
+    abort();
+}
+
+#define STUB(name) extern "C" __attribute__((weak)) void name(void) { missing(#name); }
+
+STUB(acm_reset)
+STUB(clHCA_Decode)
+STUB(clHCA_DecodeSamples16)
+STUB(decode_acm)
+STUB(decode_apple_ima4)
+STUB(decode_baf_adpcm)
+STUB(decode_cbd2)
+STUB(decode_dat4_ima)
+STUB(decode_dvi_ima)
+STUB(decode_ffxi_adpcm)
+STUB(decode_ima)
+STUB(decode_invert_psx)
+STUB(decode_ngc_afc)
+STUB(decode_pcm8_unsigned)
+STUB(decode_psx)
+STUB(decode_psx_badflags)
+STUB(decode_rad_ima_mono)
+STUB(decode_sdx2)
+STUB(get_vgmstream_samples_per_frame)
+STUB(ov_info)
+STUB(ov_read_float)
+STUB(seek_nwa)